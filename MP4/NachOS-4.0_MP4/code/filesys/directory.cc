@@ -21,8 +21,10 @@
 
 #include "copyright.h"
 #include "utility.h"
+#include "debug.h"
 #include "filehdr.h"
 #include "directory.h"
+#include "main.h"
 
 //----------------------------------------------------------------------
 // Directory::Directory
@@ -41,10 +43,12 @@ Directory::Directory(int size)
 	// // MP4 mod tag
 	memset(table, 0, sizeof(DirectoryEntry) * size);  // dummy operation to keep valgrind happy
     tableSize = size;
+    dirty = new bool[size];
     for (int i = 0; i < tableSize; i++) {
         table[i].inUse = FALSE;
         table[i].isDir = FALSE;
         table[i].sector = -1;
+        dirty[i] = TRUE;	// a fresh directory has never been written
     }
 }
 
@@ -56,6 +60,7 @@ Directory::Directory(int size)
 Directory::~Directory()
 { 
     delete [] table;
+    delete [] dirty;
 } 
 
 //----------------------------------------------------------------------
@@ -69,19 +74,54 @@ void
 Directory::FetchFrom(OpenFile *file)
 {
     (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    for (int i = 0; i < tableSize; i++)
+        dirty[i] = FALSE;
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
 // 	Write any modifications to the directory back to disk
 //
+//	Only the sectors of the directory file that hold an entry modified
+//	since the last FetchFrom/WriteBack are written, so adding or
+//	removing one file costs one or two sector writes no matter how
+//	big the directory is.  Runs of adjacent dirty sectors are written
+//	with a single WriteAt.  Whole sectors are written from the
+//	in-memory table, so WriteAt never has to read anything back in.
+//
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
 
 void
 Directory::WriteBack(OpenFile *file)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    int tableBytes = tableSize * sizeof(DirectoryEntry);
+    int numSectors = divRoundUp(tableBytes, SectorSize);
+    int runStart = -1;			// first byte of the pending run
+
+    for (int s = 0; s <= numSectors; s++) {
+        bool sectorDirty = FALSE;
+        int start = s * SectorSize;
+
+        if (s < numSectors) {
+            int end = min(start + SectorSize, tableBytes);
+            int first = start / sizeof(DirectoryEntry);
+            int last = (end - 1) / sizeof(DirectoryEntry);
+
+            for (int i = first; i <= last && !sectorDirty; i++)
+                sectorDirty = dirty[i];
+        }
+        if (sectorDirty && runStart == -1) {
+            runStart = start;
+        } else if (!sectorDirty && runStart != -1) {
+            int runEnd = min(start, tableBytes);
+            (void) file->WriteAt((char *)table + runStart,
+					runEnd - runStart, runStart);
+            runStart = -1;
+        }
+    }
+    for (int i = 0; i < tableSize; i++)
+        dirty[i] = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -143,6 +183,7 @@ Directory::Add(char *name, int newSector, bool isDir)
             table[i].isDir = isDir;
             strncpy(table[i].name, name, FileNameMaxLen); 
             table[i].sector = newSector;
+            dirty[i] = TRUE;
         return TRUE;
 	}
     return FALSE;	// no space.  Fix when we have extensible files.
@@ -163,10 +204,44 @@ Directory::Remove(char *name)
 
     if (i == -1)
 	return FALSE; 		// name not in directory
-    table[i].inUse = FALSE;
+    RemoveEntry(i);
     return TRUE;	
 }
 
+//----------------------------------------------------------------------
+// Directory::Redirect
+// 	Make the entry for "name" point at the file header in "newSector".
+//	Used when the file's header is copied, because the old one is
+//	shared with a snapshot.
+//
+//	"name" -- the name of a file in the directory
+//	"newSector" -- the disk sector holding the copy of its header
+//----------------------------------------------------------------------
+
+void
+Directory::Redirect(char *name, int newSector)
+{ 
+    int i = FindIndex(name);
+
+    ASSERT(i != -1);
+    table[i].sector = newSector;
+    dirty[i] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::RemoveEntry
+// 	Remove entry "i" from the directory.  Used by the consistency
+//	checker, which can't trust the entry's name to be unique.
+//----------------------------------------------------------------------
+
+void
+Directory::RemoveEntry(int i)
+{ 
+    ASSERT(i >= 0 && i < tableSize);
+    table[i].inUse = FALSE;
+    dirty[i] = TRUE;
+}
+
 //----------------------------------------------------------------------
 // Directory::List
 // 	List all the file names in the directory. 
@@ -206,6 +281,30 @@ Directory::RecursiveList(int indent)
     delete childDirectory;
 }
 
+//----------------------------------------------------------------------
+// Directory::LongList
+// 	List the files in the directory with their attributes, one per
+//	line: type, number of names, size in bytes, and the ticks at
+//	which the file was created and last written.  The headers come
+//	from the table of in-core headers, so listing the directory
+//	again reads no headers from disk.
+//----------------------------------------------------------------------
+
+void
+Directory::LongList()
+{
+    FileHeader *hdr;
+
+    for (int i = 0; i < tableSize; i++)
+	if (table[i].inUse) {
+	    hdr = kernel->openFileTable->Open(table[i].sector);
+	    printf("%c %3d %8d %10d %10d %s\n", table[i].isDir ? 'd' : '-',
+		    hdr->Links(), hdr->FileLength(), hdr->CreateTime(),
+		    hdr->ModifyTime(), table[i].name);
+	    kernel->openFileTable->Close(table[i].sector, hdr);
+	}
+}
+
 //----------------------------------------------------------------------
 // Directory::Print
 // 	List all the file names in the directory, their FileHeader locations,
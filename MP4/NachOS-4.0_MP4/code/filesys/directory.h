@@ -58,6 +58,8 @@ class Directory {
     void FetchFrom(OpenFile *file);  	// Init directory contents from disk
     void WriteBack(OpenFile *file);	// Write modifications to 
 					// directory contents back to disk
+					// (only the sectors holding
+					// entries changed since FetchFrom)
 
     int Find(char *name);		// Find the sector number of the 
 					// FileHeader for file: "name"
@@ -66,25 +68,39 @@ class Directory {
 
     bool Remove(char *name);		// Remove a file from the directory
 
+    void Redirect(char *name, int newSector);
+					// Point "name" at a copy of its
+					// header, at "newSector"
+
     void List();			// Print the names of all the files
     void RecursiveList(int indent);
 					//  in the directory
+    void LongList();			// Print them with their attributes
     void Print();			// Verbose print of the contents
 					//  of the directory -- all the file
 					//  names and their contents.
     bool IsDir(char *name){int index = FindIndex(name); return table[index].isDir; }
 
+    int TableSize() { return tableSize; }
+    DirectoryEntry *Entry(int i) { return &table[i]; }
+					// Entry "i" of the table, for
+					//  the consistency checker
+    void RemoveEntry(int i);		// Remove entry "i", whatever its name
+
   private:
   
 	/*
 		MP4 Hint:
 		Directory is actually a "file", be careful of how it works with OpenFile and FileHdr.
 		Disk part: table
-		In-core part: tableSize
+		In-core part: tableSize, dirty
 	*/
   
     int tableSize;			// Number of directory entries
     DirectoryEntry *table;		// Table of pairs:
+    bool *dirty;			// dirty[i] is TRUE if table[i] was
+					// changed since it was last read
+					// from or written to disk
 
     int FindIndex(char *name);		// Find the index into the directory 
 					//  table corresponding to "name"
@@ -10,8 +10,9 @@
 //	blocks). The table size is chosen so that the file header
 //	will be just big enough to fit in one disk sector, 
 //
-//      Unlike in a real system, we do not keep track of file permissions, 
-//	ownership, last modification date, etc., in the file header. 
+//      Unlike in a real system, we do not keep track of file permissions
+//	or ownership in the file header; we do keep the number of names
+//	the file has, and when it was created and last written.
 //
 //	A file header can be initialized in two ways:
 //	   for a new file, by modifying the in-memory data structure
@@ -27,6 +28,7 @@
 #include "filehdr.h"
 #include "debug.h"
 #include "synchdisk.h"
+#include "snapshot.h"
 #include "main.h"
 
 //----------------------------------------------------------------------
@@ -40,19 +42,22 @@ FileHeader::FileHeader()
 {
 	numBytes = -1;
 	numSectors = -1;
+	numLinks = 0;
+	createTime = modifyTime = 0;
 	memset(dataSectors, -1, sizeof(dataSectors));
+	dataIndex = NULL;
+	refCount = 0;
+	dirty = FALSE;
 }
 
 //----------------------------------------------------------------------
 // MP4 mod tag
 // FileHeader::~FileHeader
-//	Currently, there is not need to do anything in destructor function.
-//	However, if you decide to add some "in-core" data in header
-//	Always remember to deallocate their space or you will leak memory
+//	Deallocate the in-core copy of the index sectors.
 //----------------------------------------------------------------------
 FileHeader::~FileHeader()
 {
-	// nothing to do now
+	delete [] dataIndex;
 }
 
 //----------------------------------------------------------------------
@@ -71,34 +76,34 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 { 
     numBytes = fileSize;
     numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors)
+    numLinks = 1;			// the name it is created under
+    createTime = modifyTime = kernel->stats->totalTicks;
+	int numIdx = divRoundUp(numSectors, NumIndexEntries);
+    if (numIdx > (int)NumDirect || freeMap->NumClear() < numSectors + numIdx)
 		return FALSE;		// not enough space
 
-    int numtoAllocate = numSectors;
-	int numIdx = 0;
-	while (numtoAllocate > 0){
-		dataSectors[numIdx] = freeMap->FindAndSet(); // index
-		ASSERT(dataSectors[numIdx] >= 0);
-	
-		int index[32]; // in index
-		memset(index,-1,sizeof(index));
-		for(int i = 0; i < 32; i++) {
-			index[i] = freeMap->FindAndSet();
-			ASSERT(index[i] >= 0);
-			numtoAllocate--;
-			if(numtoAllocate == 0)
-				break;
-		}
-		kernel->synchDisk->WriteSector(dataSectors[numIdx], (char*)index);
+	delete [] dataIndex;
+	dataIndex = new int[numIdx * NumIndexEntries];
+	memset(dataIndex, -1, numIdx * NumIndexEntries * sizeof(int));
+
+	for (int i = 0; i < numIdx; i++) {
+		dataSectors[i] = freeMap->FindAndSet(); // index
+		ASSERT(dataSectors[i] >= 0);
+	}
 
-		numIdx++;
+	// lay the data out as one run if the disk has room for it, so
+	// that the file can be written and read back sequentially
+	int first = freeMap->FindAndSetRun(numSectors);
+	for (int i = 0; i < numSectors; i++) {
+		dataIndex[i] = (first >= 0) ? first + i : freeMap->FindAndSet();
+		// since we checked that there was enough free space,
+		// we expect this to succeed
+		ASSERT(dataIndex[i] >= 0);
 	}
-	// for (int i = 0; i < numSectors; i++) {
-	// 	dataSectors[i] = freeMap->FindAndSet();
-	// 	// since we checked that there was enough free space,
-	// 	// we expect this to succeed
-	// 	ASSERT(dataSectors[i] >= 0);
-    // }
+
+	for (int i = 0; i < numIdx; i++)
+		kernel->synchDisk->WriteSector(dataSectors[i], 
+				(char *)&dataIndex[i * NumIndexEntries]);
     return TRUE;
 }
 
@@ -106,33 +111,32 @@ FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 // FileHeader::Deallocate
 // 	De-allocate all the space allocated for data blocks for this file.
 //
+//	Sectors shared with a snapshot just lose a reference.  A shared
+//	index sector is still pointed at by the snapshot's copy of the
+//	header, which keeps the data sectors under it as well, so those
+//	aren't even looked at.
+//
 //	"freeMap" is the bit map of free disk sectors
+//	"snapshots" keeps the share count of every sector
 //----------------------------------------------------------------------
 
 void 
-FileHeader::Deallocate(PersistentBitmap *freeMap)
-{
-	int numtoDeAllocate = numSectors;
-	int numIdx = 0;
-	while(numtoDeAllocate > 0){
-		int index[32];
-		kernel->synchDisk->ReadSector(dataSectors[numIdx], (char*)index); // get data sector number
-		for(int i = 0; i < 32; i++){
-			ASSERT(freeMap->Test((int) index[i]));  // ought to be marked!
-			freeMap->Clear((int) index[i]);
-			
-			numtoDeAllocate--;
-			if(numtoDeAllocate == 0)
-				break;
+FileHeader::Deallocate(PersistentBitmap *freeMap, SnapshotTable *snapshots)
+{
+	LoadIndex();
+	for (int i = 0; i < (int) divRoundUp(numSectors, NumIndexEntries); i++) {
+		if (snapshots->Release(dataSectors[i]))
+			continue;
+		for (int j = i * NumIndexEntries; 
+				j < min((i + 1) * (int)NumIndexEntries, numSectors); j++) {
+			if (snapshots->Release(dataIndex[j]))
+				continue;
+			ASSERT(freeMap->Test((int) dataIndex[j]));  // ought to be marked!
+			freeMap->Clear((int) dataIndex[j]);
 		}
-
-		numIdx++;
+		ASSERT(freeMap->Test((int) dataSectors[i]));
+		freeMap->Clear((int) dataSectors[i]);
 	}
-    // for (int i = 0; i < numSectors; i++) {
-	// 	ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-		
-	// 	freeMap->Clear((int) dataSectors[i]);
-    // }
 }
 
 //----------------------------------------------------------------------
@@ -145,13 +149,13 @@ FileHeader::Deallocate(PersistentBitmap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
+	// only the disk part is read in; the index sectors are
+	// read lazily, the first time a data sector is looked up
+	delete [] dataIndex;
+	dataIndex = NULL;
     kernel->synchDisk->ReadSector(sector, (char *)this);
-	
-	/*
-		MP4 Hint:
-		After you add some in-core informations, you will need to rebuild the header's structure
-	*/
-	
+	stats.headerFetches++;
+	dirty = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -165,6 +169,7 @@ void
 FileHeader::WriteBack(int sector)
 {
     kernel->synchDisk->WriteSector(sector, (char *)this); 
+	dirty = FALSE;
 	
 	/*
 		MP4 Hint:
@@ -190,14 +195,164 @@ FileHeader::WriteBack(int sector)
 int
 FileHeader::ByteToSector(int offset)
 {
-    int whichDataSector = offset / SectorSize;
-	int whichIdxSector = whichDataSector / 32;
-	int offsetSector = whichDataSector % 32;
-	int index[32];
-	kernel->synchDisk->ReadSector(dataSectors[whichIdxSector], (char*)index); // get data sector number
+	LoadIndex();
+	return dataIndex[offset / SectorSize];
+}
+
+//----------------------------------------------------------------------
+// FileHeader::LoadIndex
+// 	Read the file's index sectors into the in-core table "dataIndex",
+//	if that has not been done yet.  After this, mapping a file offset
+//	to its data sector is a table lookup.
+//----------------------------------------------------------------------
+
+void
+FileHeader::LoadIndex()
+{
+	if (dataIndex != NULL)
+		return;
+	int numIdx = divRoundUp(numSectors, NumIndexEntries);
+	dataIndex = new int[numIdx * NumIndexEntries];
+	for (int i = 0; i < numIdx; i++)
+		kernel->synchDisk->ReadSector(dataSectors[i], 
+				(char *)&dataIndex[i * NumIndexEntries]);
+	stats.headerFetches += numIdx;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Restore
+// 	Put the in-core state of a header just read back as a checkpoint
+//	of the machine had it (see FileSystem::Save): "changed" if its
+//	modification time was yet to be written back, and "indexed" if
+//	its index sectors had been read, so that they aren't again.
+//----------------------------------------------------------------------
+
+void
+FileHeader::Restore(bool changed, bool indexed)
+{
+	dirty = changed;
+	if (indexed)
+		LoadIndex();
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ListSectors
+// 	Check that the header makes sense -- its length agrees with its
+//	sector count, it has a name, and every sector it points to is on
+//	the disk --
+//	and list the index and data sectors of the file in "sectors",
+//	which must have room for MaxHeaderSectors entries.
+//
+//	Return the number of sectors listed, or -1 if the header is
+//	corrupt.  Used by the consistency checker.
+//----------------------------------------------------------------------
+
+int
+FileHeader::ListSectors(int *sectors)
+{
+	int numIdx, i, n = 0;
+
+	if (numBytes < 0 || numBytes > (int)MaxFileSize ||
+			numSectors != divRoundUp(numBytes, SectorSize) ||
+			numLinks < 1)
+		return -1;
+	numIdx = divRoundUp(numSectors, NumIndexEntries);
+	for (i = 0; i < numIdx; i++) {
+		if (dataSectors[i] < 0 || dataSectors[i] >= NumSectors)
+			return -1;
+		sectors[n++] = dataSectors[i];
+	}
+	LoadIndex();
+	for (i = 0; i < numSectors; i++) {
+		if (dataIndex[i] < 0 || dataIndex[i] >= NumSectors)
+			return -1;
+		sectors[n++] = dataIndex[i];
+	}
+	return n;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Share
+// 	A copy of this header is being made (see snapshot.h), so each of
+//	its index sectors is pointed at by one more header.
+//----------------------------------------------------------------------
+
+void
+FileHeader::Share(SnapshotTable *snapshots)
+{
+	for (int i = 0; i < (int) divRoundUp(numSectors, NumIndexEntries); i++)
+		snapshots->Share(dataSectors[i]);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::IsShared
+// 	Return TRUE if the data sector holding byte "offset", or the index
+//	sector pointing at it, is shared with a snapshot.  The header
+//	itself is assumed to be private to the live file system.
+//----------------------------------------------------------------------
+
+bool
+FileHeader::IsShared(int offset, SnapshotTable *snapshots)
+{
+	int i = offset / SectorSize;
 
-	return index[offsetSector];
-	// return(dataSectors[offset / SectorSize]);
+	LoadIndex();
+	return snapshots->Shares(dataSectors[i / NumIndexEntries]) > 0 ||
+		snapshots->Shares(dataIndex[i]) > 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::CopyOnWrite
+// 	The data sector holding byte "offset" is about to be written,
+//	but it (or its index sector) is shared with a snapshot.  Move
+//	this file's reference to a fresh sector, and return it; the
+//	caller writes the new data there.  The old contents are not
+//	copied, since the caller has already read whatever part of the
+//	sector it is keeping.
+//
+//	If the index sector is shared, it is copied first: the copy
+//	points at the same data sectors, which each gain a reference.
+//	The header is written back when it changes.
+//
+//	Return -1 if the disk is full.
+//
+//	"sector" is the disk sector holding this file header
+//	"freeMap" is the bit map of free disk sectors
+//	"snapshots" keeps the share count of every sector
+//----------------------------------------------------------------------
+
+int
+FileHeader::CopyOnWrite(int offset, int sector, PersistentBitmap *freeMap,
+		SnapshotTable *snapshots)
+{
+	int i = offset / SectorSize;
+	int idx = i / NumIndexEntries;
+	int first = idx * NumIndexEntries;
+	int copy;
+
+	LoadIndex();
+	if (freeMap->NumClear() < (snapshots->Shares(dataSectors[idx]) > 0) + 
+			(snapshots->Shares(dataIndex[i]) > 0))
+		return -1;		// not enough space
+	if (snapshots->Shares(dataSectors[idx]) > 0) {
+		copy = freeMap->FindAndSet();
+		for (int j = first; j < min(first + (int)NumIndexEntries, numSectors); j++)
+			snapshots->Share(dataIndex[j]);
+		snapshots->Release(dataSectors[idx]);
+		DEBUG(dbgFile, "Copying index sector " << dataSectors[idx] 
+				<< " to " << copy);
+		dataSectors[idx] = copy;
+		WriteBack(sector);
+	}
+	if (snapshots->Shares(dataIndex[i]) > 0) {
+		copy = freeMap->FindAndSet();
+		snapshots->Release(dataIndex[i]);
+		DEBUG(dbgFile, "Copying data sector " << dataIndex[i] 
+				<< " to " << copy);
+		dataIndex[i] = copy;
+	}
+	kernel->synchDisk->WriteSector(dataSectors[idx], (char *)&dataIndex[first]);
+	return dataIndex[i];
 }
 
 //----------------------------------------------------------------------
@@ -211,6 +366,21 @@ FileHeader::FileLength()
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::Touch
+// 	Record that the file's data was just written.  Only the in-core
+//	copy changes; the header is written back when its last opener
+//	closes it (see OpenFileTable::Close), so a stream of writes costs
+//	no extra disk I/O.
+//----------------------------------------------------------------------
+
+void
+FileHeader::Touch()
+{
+    modifyTime = kernel->stats->totalTicks;
+    dirty = TRUE;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Print
 // 	Print the contents of the file header, and the contents of all
@@ -223,12 +393,13 @@ FileHeader::Print()
     int i, j, k;
     char *data = new char[SectorSize];
 
+    LoadIndex();
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
     for (i = 0; i < numSectors; i++)
-	printf("%d ", dataSectors[i]);
+	printf("%d ", dataIndex[i]);
     printf("\nFile contents:\n");
     for (i = k = 0; i < numSectors; i++) {
-	kernel->synchDisk->ReadSector(dataSectors[i], data);
+	kernel->synchDisk->ReadSector(dataIndex[i], data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
 		printf("%c", data[j]);
@@ -239,3 +410,56 @@ FileHeader::Print()
     }
     delete [] data;
 }
+
+//----------------------------------------------------------------------
+// FileStats::FileStats
+// 	Initialize the counts of a file's I/O to zero.
+//----------------------------------------------------------------------
+
+FileStats::FileStats()
+{
+    bytesRead = bytesWritten = 0;
+    sectorsRead = sectorsWritten = 0;
+    cacheHits = headerFetches = 0;
+}
+
+//----------------------------------------------------------------------
+// FileStats::Add
+// 	Add the counts in "other" to these, to total up a directory.
+//----------------------------------------------------------------------
+
+void
+FileStats::Add(FileStats *other)
+{
+    bytesRead += other->bytesRead;
+    bytesWritten += other->bytesWritten;
+    sectorsRead += other->sectorsRead;
+    sectorsWritten += other->sectorsWritten;
+    cacheHits += other->cacheHits;
+    headerFetches += other->headerFetches;
+}
+
+//----------------------------------------------------------------------
+// FileStats::IsZero
+// 	Return TRUE if no I/O has been counted.
+//----------------------------------------------------------------------
+
+bool
+FileStats::IsZero()
+{
+    return bytesRead == 0 && bytesWritten == 0 && sectorsRead == 0 &&
+	sectorsWritten == 0 && cacheHits == 0 && headerFetches == 0;
+}
+
+//----------------------------------------------------------------------
+// FileStats::Print
+// 	Print the counts on one line, followed by "name".  The columns
+//	are headed by FileSystem::PrintStats.
+//----------------------------------------------------------------------
+
+void
+FileStats::Print(const char *name)
+{
+    printf("%9d %9d %7d %7d %6d %6d  %s\n", bytesRead, bytesWritten,
+	sectorsRead, sectorsWritten, cacheHits, headerFetches, name);
+}
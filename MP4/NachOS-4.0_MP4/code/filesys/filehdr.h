@@ -17,8 +17,29 @@
 #include "disk.h"
 #include "pbitmap.h"
 
-#define NumDirect 	((SectorSize - 2 * sizeof(int)) / sizeof(int)) //  one sector can store 32 number
-#define MaxFileSize 	(NumDirect * SectorSize) // each number point a sector
+class SnapshotTable;
+
+#define NumDirect 	((SectorSize - 5 * sizeof(int)) / sizeof(int)) //  one sector can store 32 numbers, 5 of them not sectors
+#define NumIndexEntries	(SectorSize / sizeof(int))	// data sectors per index sector
+#define MaxFileSize 	(NumDirect * NumIndexEntries * SectorSize) // each number point an index sector
+#define MaxHeaderSectors	(NumDirect * (NumIndexEntries + 1)) // index and data sectors of a file
+
+// The I/O done through one file since its header was read in, for
+// the hot-file report (FileSystem::PrintStats).  Like Statistics, the
+// fields are public to make them easier to update.
+
+class FileStats {
+  public:
+    int bytesRead, bytesWritten;	// bytes asked for by ReadAt/WriteAt
+    int sectorsRead, sectorsWritten;	// data sectors they transferred
+    int cacheHits;			// opens that found the header in core
+    int headerFetches;			// header and index sectors read
+
+    FileStats();			// initialize everything to zero
+    void Add(FileStats *other);		// add "other" into these counts
+    bool IsZero();			// nothing done through the file?
+    void Print(const char *name);	// print one line of the report
+};
 
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
@@ -37,6 +58,7 @@
 // reading it from disk.
 
 class FileHeader {
+  friend class OpenFileTable;		// keeps count of a header's openers
   public:
 	// MP4 mod tag
 	FileHeader(); // dummy constructor to keep valgrind happy
@@ -45,8 +67,10 @@ class FileHeader {
     bool Allocate(PersistentBitmap *bitMap, int fileSize);// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
-    void Deallocate(PersistentBitmap *bitMap);  // De-allocate this file's 
-						//  data blocks
+    void Deallocate(PersistentBitmap *bitMap, SnapshotTable *snapshots);
+						// De-allocate this file's 
+						//  data blocks, except the
+						//  ones a snapshot still uses
 
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
@@ -61,7 +85,45 @@ class FileHeader {
 
     void Print();			// Print the contents of the file.
 
+    int ListSectors(int *sectors);	// Put the file's index and data
+					// sectors in "sectors" and return
+					// how many; -1 if the header is
+					// corrupt
+
+    void Share(SnapshotTable *snapshots);
+					// This header is being copied: add
+					// a reference to its index sectors
+    bool IsShared(int offset, SnapshotTable *snapshots);
+					// Must the sector holding "offset"
+					// be copied before it is written?
+    int CopyOnWrite(int offset, int sector, PersistentBitmap *freeMap,
+		SnapshotTable *snapshots);
+					// Give this file (whose header is
+					// in "sector") its own copy of the
+					// sector holding "offset"
+
+    FileStats *Stats() { return &stats; }
+					// I/O counted against this file
+
+    int Links() { return numLinks; }	// Number of names the file has
+    void SetLinks(int n) { numLinks = n; }
+					// Change it; the caller writes
+					// the header back
+
+    int CreateTime() { return createTime; }
+    int ModifyTime() { return modifyTime; }
+					// In ticks, like Statistics
+    void Touch();			// The file's data was just written
+    bool IsDirty() { return dirty; }	// Changed since last written back?
+    bool HasIndex() { return dataIndex != NULL; }
+					// Are the index sectors in core?
+    void Restore(bool changed, bool indexed);
+					// Be as a checkpoint had it: dirty
+					// or not, with its index in core
+					// or not
+
   private:
+    void LoadIndex();			// Read the index sectors into dataIndex
 	
 	/*
 		MP4 hint:
@@ -72,14 +134,18 @@ class FileHeader {
 		In order to implement a data structure, you will need to add some "in-core" data
 		to maintain data structure.
 		
-		Disk Part - numBytes, numSectors, dataSectors occupy exactly 128 bytes and will be
-		written to a sector on disk.
-		In-core part - none
+		Disk Part - numBytes, numSectors, numLinks, createTime, modifyTime, dataSectors occupy
+		exactly 128 bytes and will be written to a sector on disk.
+		In-core part - dataIndex, refCount, stats, dirty
 		
 	*/
 	
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
+    int numLinks;			// Number of directory entries naming
+					// the file (in each tree it is in)
+    int createTime;			// totalTicks when it was created
+    int modifyTime;			// totalTicks when it was last written
 	//==========MP4=======//
 	// int numIdxSectors = 8;
 	// int idxSectors[NumIdx];
@@ -88,6 +154,14 @@ class FileHeader {
     	
 	// Disk sector numbers for each data 
 					// block in the file
+
+    int *dataIndex;			// in-core copy of the index sectors,
+					// so ByteToSector needs no disk read;
+					// NULL until first needed
+    int refCount;			// OpenFiles sharing this header
+    FileStats stats;			// I/O through this file
+    bool dirty;				// modifyTime changed since the header
+					// was last read or written
 };
 
 #endif // FILEHDR_H
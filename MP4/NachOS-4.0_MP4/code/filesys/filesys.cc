@@ -21,12 +21,16 @@
 //	The file system assumes that the bitmap and directory files are
 //	kept "open" continuously while Nachos is running.
 //
+//	A third file, whose header is in the sector after the log, holds
+//	the snapshots of the file system and the share count of every
+//	sector (see snapshot.h).
+//
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	are handed to the journal, which commits the updates of several
+//	operations together (see journal.h).  If the operation fails, and
+//	we have modified part of the directory and/or bitmap, we simply
+//	discard the changed version, without writing it back to disk.
 //
 // 	Our implementation at this point has the following restrictions:
 //
@@ -35,9 +39,8 @@
 //	   files cannot be bigger than about 3KB in size
 //	   there is no hierarchical directory structure, and only a limited
 //	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   only metadata is journaled: if Nachos exits in the middle of
+//	    writing a file's data, the file may be left half written
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -51,6 +54,10 @@
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "journal.h"
+#include "snapshot.h"
+#include "synchdisk.h"
+#include "main.h"
 #include <string.h>
 #include <libgen.h>
 
@@ -83,11 +90,15 @@
 FileSystem::FileSystem(bool format)
 { 
     DEBUG(dbgFile, "Initializing the file system.");
+
+	// replay the log before anything else looks at the disk
+	journal = new Journal(format);
     if (format) {
         PersistentBitmap *freeMap = new PersistentBitmap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
 		FileHeader *mapHdr = new FileHeader;
 		FileHeader *dirHdr = new FileHeader;
+		FileHeader *snapHdr = new FileHeader;
 
         DEBUG(dbgFile, "Formatting the file system.");
 
@@ -95,12 +106,16 @@ FileSystem::FileSystem(bool format)
 		// (make sure no one else grabs these!)
 		freeMap->Mark(FreeMapSector);	    
 		freeMap->Mark(DirectorySector);
+		for (int i = 0; i < (int) JournalSectors; i++)
+			freeMap->Mark(JournalSector + i);
+		freeMap->Mark(SnapshotSector);
 
 		// Second, allocate space for the data blocks containing the contents
 		// of the directory and bitmap files.  There better be enough space!
 
 		ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize));
 		ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize));
+		ASSERT(snapHdr->Allocate(freeMap, SnapshotFileSize));
 
 		// Flush the bitmap and directory FileHeaders back to disk
 		// We need to do this before we can "Open" the file, since open
@@ -110,6 +125,7 @@ FileSystem::FileSystem(bool format)
         DEBUG(dbgFile, "Writing headers back to disk.");
 		mapHdr->WriteBack(FreeMapSector);    
 		dirHdr->WriteBack(DirectorySector);
+		snapHdr->WriteBack(SnapshotSector);
 
 		// OK to open the bitmap and directory files now
 		// The file system operations assume these two files are left open
@@ -117,6 +133,8 @@ FileSystem::FileSystem(bool format)
 
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+        snapshotFile = new OpenFile(SnapshotSector);
+        snapshots = new SnapshotTable;
      
 		// Once we have the files "open", we can write the initial version
 		// of each file back to disk.  The directory at this point is completely
@@ -127,6 +145,7 @@ FileSystem::FileSystem(bool format)
         DEBUG(dbgFile, "Writing bitmap and directory back to disk.");
 		freeMap->WriteBack(freeMapFile);	 // flush changes to disk
 		directory->WriteBack(directoryFile);
+		snapshots->WriteBack(snapshotFile);
 
 		if (debug->IsEnabled('f')) {
 			freeMap->Print();
@@ -136,13 +155,20 @@ FileSystem::FileSystem(bool format)
 		delete directory; 
 		delete mapHdr; 
 		delete dirHdr;
+		delete snapHdr;
     } else {
 		// if we are not formatting the disk, just open the files representing
 		// the bitmap and directory; these are left open while Nachos is running
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+        snapshotFile = new OpenFile(SnapshotSector);
+        snapshots = new SnapshotTable;
+        snapshots->FetchFrom(snapshotFile);
     }
-    currentfile = NULL;
+	rootFile = directoryFile;
+	checking = FALSE;
+	journal->Mount(freeMapFile);
+	kernel->synchDisk->SetJournal(journal);
 }
 
 //----------------------------------------------------------------------
@@ -151,8 +177,16 @@ FileSystem::FileSystem(bool format)
 //----------------------------------------------------------------------
 FileSystem::~FileSystem()
 {
+	kernel->openFileTable->Flush();		// modification times
+	journal->Commit();
+	kernel->synchDisk->SetJournal(NULL);
+	delete journal;
+	if (rootFile != directoryFile)
+		delete rootFile;
 	delete freeMapFile;
 	delete directoryFile;
+	delete snapshotFile;
+	delete snapshots;
 }
 
 //----------------------------------------------------------------------
@@ -196,13 +230,15 @@ FileSystem::Create(char *name, int initialSize)
     char *parent_dir_name, *element_name;
 
     DEBUG(dbgFile, "Creating file " << name << " size " << initialSize);
+    if (rootFile != directoryFile)
+        return FALSE;			// a snapshot is mounted read-only
 
     // directory = new Directory(NumDirEntries);
     // directory->FetchFrom(directoryFile);
     parent_dir_name = getDirName(name);
     element_name = getFileName(name);
 
-    dir_file = FindDirectory(parent_dir_name);
+    dir_file = FindDirectory(parent_dir_name, TRUE);
     if (dir_file == NULL) {
         
         
@@ -211,6 +247,7 @@ FileSystem::Create(char *name, int initialSize)
     directory = new Directory(NumDirEntries);
     directory->FetchFrom(dir_file);
 
+    journal->Begin();
     if (directory->Find(element_name) != -1)
       success = FALSE;			// file is already in directory
     else {	
@@ -226,16 +263,19 @@ FileSystem::Create(char *name, int initialSize)
                 success = FALSE;	// no space on disk for data
             else {	
                 success = TRUE;
-                // everthing worked, flush all changes back to disk
+                // everthing worked, flush all changes back to disk;
+                // the map goes first, since writing the directory may
+                // have to copy sectors it shares with a snapshot
                 hdr->WriteBack(sector); 
-                directory->WriteBack(dir_file);
                 freeMap->WriteBack(freeMapFile);
+                directory->WriteBack(dir_file);
             }
             delete hdr;
         }
         delete freeMap;
     }
-    if (dir_file != directoryFile)
+    journal->End();
+    if (dir_file != rootFile)
         delete dir_file;
     delete directory;
     
@@ -255,10 +295,12 @@ FileSystem::CreateDirectory(char *name)
     char *parent_dir_name, *element_name;
 
     DEBUG(dbgFile, "Creating directory " << name);
+    if (rootFile != directoryFile)
+        return FALSE;			// a snapshot is mounted read-only
     
     parent_dir_name = getDirName(name);
     element_name = getFileName(name);
-    dir_file = FindDirectory(parent_dir_name);
+    dir_file = FindDirectory(parent_dir_name, TRUE);
     if (dir_file == NULL) {
         
 
@@ -267,6 +309,7 @@ FileSystem::CreateDirectory(char *name)
     directory = new Directory(NumDirEntries);
     directory->FetchFrom(dir_file);
 
+    journal->Begin();
     if (directory->Find(element_name) != -1)
       success = FALSE;			// file is already in directory
     else {	
@@ -287,8 +330,8 @@ FileSystem::CreateDirectory(char *name)
                 new_directory = new Directory(NumDirEntries);
                 new_dir_file = new OpenFile(sector); // open new dir file using new FCB(hdr)		
                 new_directory->WriteBack(new_dir_file); // clean sectors of dir file
-                directory->WriteBack(dir_file);
                 freeMap->WriteBack(freeMapFile);
+                directory->WriteBack(dir_file);
                 delete new_directory;
                 delete new_dir_file;
             }
@@ -296,8 +339,9 @@ FileSystem::CreateDirectory(char *name)
         }
         delete freeMap;
     }
+    journal->End();
     delete directory;
-    if (dir_file != directoryFile)
+    if (dir_file != rootFile)
         delete dir_file;
     return success;
 }
@@ -309,6 +353,10 @@ FileSystem::CreateDirectory(char *name)
 //	  Find the location of the file's header, using the directory 
 //	  Bring the header into memory
 //
+//	Opening a file that a snapshot shares gives it a header of its
+//	own, so that it can be written (see snapshot.h).  A file opened
+//	in a mounted snapshot is read-only.
+//
 //	"name" -- the text name of the file to be opened
 //----------------------------------------------------------------------
 
@@ -325,7 +373,7 @@ FileSystem::Open(char *name)
     parent_dir_name = getDirName(name);
     element_name = getFileName(name);
 
-    dir_file = FindDirectory(parent_dir_name);
+    dir_file = FindDirectory(parent_dir_name, TRUE);
     if (dir_file == NULL) {
         
         
@@ -334,17 +382,19 @@ FileSystem::Open(char *name)
     directory = new Directory(NumDirEntries);
     directory->FetchFrom(dir_file);
 
-    sector = directory->Find(element_name); 
-    if (sector >= 0) 		
+    sector = Unshare(directory, dir_file, element_name); 
+    if (sector >= 0) {		
 	    openFile = new OpenFile(sector);	// name was found in directory 
-    else
+	    if (rootFile != directoryFile)
+	        openFile->SetReadOnly();
+	    else if (directory->IsDir(element_name))
+	        (void) UnshareDirectory(openFile);
+    } else
         openFile = NULL;
 
     delete directory;
-    if (dir_file != directoryFile)
+    if (dir_file != rootFile)
         delete dir_file;
-    if (openFile != NULL)
-        currentfile = openFile;
     
     
     return openFile;				// return NULL if not found
@@ -361,6 +411,11 @@ FileSystem::Open(char *name)
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
 //	in the file system.
 //
+//	If a snapshot shares the file, or some of its sectors, those stay
+//	on disk; the live file system just drops its reference to them.
+//	If the file has other names, only this one goes, and the file
+//	has one link fewer.
+//
 //	"name" -- the text name of the file to be removed
 //----------------------------------------------------------------------
 
@@ -371,15 +426,17 @@ FileSystem::Remove(char *name) // name = dir path + file name
     OpenFile *dir_file;
     PersistentBitmap *freeMap;
     FileHeader *fileHdr;
-    int sector;
+    int sector, links;
     char *parent_dir_name, *element_name;
     
+    if (rootFile != directoryFile)
+        return FALSE;			// a snapshot is mounted read-only
     // directory = new Directory(NumDirEntries);
     // directory->FetchFrom(directoryFile);
     parent_dir_name = getDirName(name); // only dir path
     element_name = getFileName(name); // only file name
 
-    dir_file = FindDirectory(parent_dir_name);
+    dir_file = FindDirectory(parent_dir_name, TRUE);
     if (dir_file == NULL) {
         
         return FALSE;//parent directory not foud
@@ -388,24 +445,48 @@ FileSystem::Remove(char *name) // name = dir path + file name
     directory->FetchFrom(dir_file);
 
     sector = directory->Find(element_name);
+    if (sector != -1) {
+        fileHdr = kernel->openFileTable->Open(sector);
+        links = fileHdr->Links();
+        kernel->openFileTable->Close(sector, fileHdr);
+        if (links > 1)			// its link count is about to change
+            sector = Unshare(directory, dir_file, element_name);
+    }
     if (sector == -1) {
+       if (dir_file != rootFile)
+           delete dir_file;
        delete directory;
        return FALSE;			 // file not found 
     }
-    fileHdr = new FileHeader;
-    fileHdr->FetchFrom(sector);
-
+    journal->Begin();
     freeMap = new PersistentBitmap(freeMapFile,NumSectors);
 
-    fileHdr->Deallocate(freeMap);  		// remove data blocks
-    freeMap->Clear(sector);			// remove header block
+    fileHdr = kernel->openFileTable->Open(sector);
+    if (fileHdr->Links() > 1) {
+        fileHdr->SetLinks(fileHdr->Links() - 1);
+        fileHdr->WriteBack(sector);
+        snapshots->Release(sector);	// one name fewer points at it
+        kernel->openFileTable->Close(sector, fileHdr);
+        fileHdr = NULL;
+    } else if (snapshots->Release(sector)) {
+        kernel->openFileTable->Close(sector, fileHdr);
+        fileHdr = NULL;			// a snapshot still has the file
+    } else {
+        fileHdr->Deallocate(freeMap, snapshots);  	// remove data blocks
+        freeMap->Clear(sector);			// remove header block
+    }
     directory->Remove(element_name);
 
     freeMap->WriteBack(freeMapFile);		// flush to disk
+    snapshots->WriteBack(snapshotFile);
     directory->WriteBack(dir_file);        // flush to disk
-    if (dir_file != directoryFile)
+    journal->End();
+    if (dir_file != rootFile)
         delete dir_file;
-    delete fileHdr;
+    if (fileHdr != NULL) {
+        kernel->openFileTable->Forget(sector);	// the sector is free now
+        kernel->openFileTable->Close(sector, fileHdr);
+    }
     delete directory;
     delete freeMap;
     
@@ -413,6 +494,360 @@ FileSystem::Remove(char *name) // name = dir path + file name
     return TRUE;
 } 
 
+//----------------------------------------------------------------------
+// FileSystem::RemoveTree
+// 	Delete the file or directory "name", and everything below it, in
+//	one pass.  Remove would look the path of every file up again from
+//	the root, and write the free map and the file's directory back
+//	each time; here the tree is walked once, the freed sectors are
+//	collected in one in-memory free map, and the free map, the share
+//	counts and the parent directory are each written once.  The
+//	directories being deleted are never written at all.
+//
+//	Files in the tree that have other names are removed one at a
+//	time first, with Remove, since their link counts change; that is
+//	the rare case.
+//
+//	Return FALSE if "name" isn't there.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::RemoveTree(char *name)
+{
+    Directory *directory;
+    OpenFile *dirFile;
+    PersistentBitmap *freeMap;
+    char *elementName = getFileName(name);
+    char **paths;
+    int i, n = 0, sector;
+    bool isDir;
+
+    DEBUG(dbgFile, "Removing tree " << name);
+    if (rootFile != directoryFile || strcmp(name, "/") == 0)
+	return FALSE;			// read-only, or the root
+
+    dirFile = FindDirectory(getDirName(name), TRUE);
+    if (dirFile == NULL)
+	return FALSE;
+    directory = new Directory(NumDirEntries);
+    directory->FetchFrom(dirFile);
+    sector = directory->Find(elementName);
+    if (sector == -1) {
+	if (dirFile != rootFile)
+	    delete dirFile;
+	delete directory;
+	return FALSE;
+    }
+    isDir = directory->IsDir(elementName);
+    if (isDir) {
+	paths = new char *[NumSectors];
+	FindMultiLinks(sector, name, paths, &n);
+	for (i = 0; i < n; i++) {
+	    (void) Remove(paths[i]);
+	    delete [] paths[i];
+	}
+	delete [] paths;
+	if (n > 0) {
+	    // Remove may have given the directory a header of its own
+	    directory->FetchFrom(dirFile);
+	    sector = directory->Find(elementName);
+	}
+    }
+
+    journal->Begin();
+    freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    directory->Remove(elementName);
+    DropFile(sector, isDir, freeMap);
+    freeMap->WriteBack(freeMapFile);
+    snapshots->WriteBack(snapshotFile);
+    directory->WriteBack(dirFile);
+    journal->End();
+
+    if (dirFile != rootFile)
+	delete dirFile;
+    delete directory;
+    delete freeMap;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::DropFile
+// 	A name pointing at the header in "sector" is gone.  If a snapshot
+//	still points at the header, that is all; otherwise free the file,
+//	and if it is a directory, first drop the names in it.
+//
+//	Only the names in data sectors that are actually freed are
+//	dropped: a data sector a snapshot shares stays, and so do the
+//	names in it (see snapshot.h).
+//
+//	"freeMap" -- the free map, written back by the caller
+//----------------------------------------------------------------------
+
+void
+FileSystem::DropFile(int sector, bool isDir, PersistentBitmap *freeMap)
+{
+    FileHeader *hdr;
+
+    if (snapshots->Release(sector))
+	return;				// a snapshot still has it
+    if (isDir) {
+	OpenFile *dirFile = new OpenFile(sector);
+	Directory *directory = new Directory(NumDirEntries);
+
+	directory->FetchFrom(dirFile);
+	for (int i = 0; i < directory->TableSize(); i++) {
+	    DirectoryEntry *entry = directory->Entry(i);
+	    int pos = (char *)&entry->sector - (char *)directory->Entry(0);
+
+	    if (entry->inUse && !dirFile->Header()->IsShared(pos, snapshots))
+		DropFile(entry->sector, entry->isDir, freeMap);
+	}
+	delete directory;
+	delete dirFile;
+    }
+    hdr = kernel->openFileTable->Open(sector);
+    hdr->Deallocate(freeMap, snapshots);
+    freeMap->Clear(sector);
+    kernel->openFileTable->Forget(sector);	// the sector is free now
+    kernel->openFileTable->Close(sector, hdr);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindMultiLinks
+// 	Put the path of every file below the directory whose header is in
+//	"sector" that has more than one name in "paths", counting them in
+//	"n".
+//
+//	"path" -- the directory's name
+//----------------------------------------------------------------------
+
+void
+FileSystem::FindMultiLinks(int sector, char *path, char **paths, int *n)
+{
+    OpenFile *dirFile = new OpenFile(sector);
+    Directory *directory = new Directory(NumDirEntries);
+
+    directory->FetchFrom(dirFile);
+    for (int i = 0; i < directory->TableSize(); i++) {
+	DirectoryEntry *entry = directory->Entry(i);
+	char *child;
+	FileHeader *hdr;
+
+	if (!entry->inUse)
+	    continue;
+	child = new char[strlen(path) + FileNameMaxLen + 2];
+	sprintf(child, "%s/%.*s", path, FileNameMaxLen, entry->name);
+	if (entry->isDir) {
+	    FindMultiLinks(entry->sector, child, paths, n);
+	    delete [] child;
+	    continue;
+	}
+	hdr = kernel->openFileTable->Open(entry->sector);
+	if (hdr->Links() > 1 && *n < NumSectors)
+	    paths[(*n)++] = child;
+	else
+	    delete [] child;
+	kernel->openFileTable->Close(entry->sector, hdr);
+    }
+    delete directory;
+    delete dirFile;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Rename
+// 	Give the file (or directory) "from" the name "to", which may be
+//	in another directory.  Only the directory entries change; the
+//	file keeps its header and data where they are.
+//
+//	If "to" is already a file, and "from" is one too, "to" is removed
+//	in the same transaction, as Remove would, so a crash leaves either
+//	the old file or the new one under that name.  If they are names
+//	of the same file, nothing changes.
+//
+//	Return FALSE if "from" isn't there, "to" is a directory (or is
+//	there and "from" is one), or "to"'s directory is full; or if a
+//	directory would move inside itself.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Rename(char *from, char *to)
+{
+    Directory *fromDir, *toDir;
+    OpenFile *fromFile, *toFile;
+    PersistentBitmap *freeMap = NULL;
+    FileHeader *hdr;
+    char *fromName, *toName;
+    int sector, target, links, len = strlen(from);
+    bool isDir, success = TRUE;
+
+    DEBUG(dbgFile, "Renaming " << from << " to " << to);
+    if (rootFile != directoryFile)
+        return FALSE;			// a snapshot is mounted read-only
+    if (strncmp(from, to, len) == 0 && to[len] == '/')
+        return FALSE;			// would be cut off from the root
+    fromName = getFileName(from);
+    toName = getFileName(to);
+    // find both directories before reading either: giving the second
+    // a header of its own may change the first
+    fromFile = FindDirectory(getDirName(from), TRUE);
+    if (fromFile == NULL)
+        return FALSE;
+    toFile = FindDirectory(getDirName(to), TRUE);
+    if (toFile == NULL) {
+        if (fromFile != rootFile)
+            delete fromFile;
+        return FALSE;
+    }
+    toDir = new Directory(NumDirEntries);
+    toDir->FetchFrom(toFile);
+    target = toDir->Find(toName);
+    if (target != -1 && !toDir->IsDir(toName)) {
+        // "to" may be replaced, and then loses a link: like Remove,
+        // give it a header of its own first if a snapshot shares it
+        hdr = kernel->openFileTable->Open(target);
+        links = hdr->Links();
+        kernel->openFileTable->Close(target, hdr);
+        if (links > 1 && Unshare(toDir, toFile, toName) == -1)
+            success = FALSE;		// the disk is full
+    }
+    // read after Unshare, which may have moved names in it
+    if (toFile->HeaderSector() == fromFile->HeaderSector())
+        fromDir = toDir;
+    else {
+        fromDir = new Directory(NumDirEntries);
+        fromDir->FetchFrom(fromFile);
+    }
+
+    journal->Begin();
+    sector = fromDir->Find(fromName);
+    target = toDir->Find(toName);
+    if (!success || sector == -1)
+        success = FALSE;		// nothing to move
+    else if (target == sector)
+        success = TRUE;			// two names of one file already
+    else if (target != -1 && (toDir->IsDir(toName) || 
+		fromDir->IsDir(fromName)))
+        success = FALSE;		// only a file replaces a file
+    else {
+        isDir = fromDir->IsDir(fromName);
+        if (target != -1) {		// drop the file "to" names now
+            freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+            hdr = kernel->openFileTable->Open(target);
+            if (hdr->Links() > 1) {
+                hdr->SetLinks(hdr->Links() - 1);
+                hdr->WriteBack(target);
+                snapshots->Release(target);
+                kernel->openFileTable->Close(target, hdr);
+            } else {
+                kernel->openFileTable->Close(target, hdr);
+                DropFile(target, FALSE, freeMap);
+            }
+            toDir->Remove(toName);
+        }
+        fromDir->Remove(fromName);
+        success = toDir->Add(toName, sector, isDir);
+        if (success) {
+            // the name moves from one private directory to another,
+            // so the header has as many references as before
+            fromDir->WriteBack(fromFile);
+            if (toDir != fromDir)
+                toDir->WriteBack(toFile);
+            if (freeMap != NULL) {
+                freeMap->WriteBack(freeMapFile);
+                snapshots->WriteBack(snapshotFile);
+            }
+        }
+    }
+    journal->End();
+    delete freeMap;
+    if (toDir != fromDir)
+        delete toDir;
+    delete fromDir;
+    if (toFile != rootFile)
+        delete toFile;
+    if (fromFile != rootFile)
+        delete fromFile;
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Link
+// 	Give the file "from" a second name, "to", which may be in another
+//	directory.  The two names share the header and data; the file
+//	goes away once all its names are removed.  Directories can't be
+//	linked, so that the tree stays a tree.
+//
+//	Return FALSE if "from" isn't there or is a directory, "to"
+//	already is there, or "to"'s directory is full.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Link(char *from, char *to)
+{
+    Directory *fromDir, *toDir;
+    OpenFile *fromFile, *toFile;
+    FileHeader *hdr;
+    char *fromName, *toName;
+    int sector;
+    bool success;
+
+    DEBUG(dbgFile, "Linking " << to << " to " << from);
+    if (rootFile != directoryFile)
+        return FALSE;			// a snapshot is mounted read-only
+    fromName = getFileName(from);
+    toName = getFileName(to);
+    fromFile = FindDirectory(getDirName(from), TRUE);
+    if (fromFile == NULL)
+        return FALSE;
+    toFile = FindDirectory(getDirName(to), TRUE);
+    if (toFile == NULL) {
+        if (fromFile != rootFile)
+            delete fromFile;
+        return FALSE;
+    }
+    fromDir = new Directory(NumDirEntries);
+    fromDir->FetchFrom(fromFile);
+    sector = fromDir->Find(fromName);
+    if (sector != -1 && !fromDir->IsDir(fromName))
+        sector = Unshare(fromDir, fromFile, fromName);	// its link count
+							// is about to change
+    else
+        sector = -1;
+    // read after Unshare, which may have moved names in it
+    if (toFile->HeaderSector() == fromFile->HeaderSector())
+        toDir = fromDir;
+    else {
+        toDir = new Directory(NumDirEntries);
+        toDir->FetchFrom(toFile);
+    }
+
+    journal->Begin();
+    if (sector == -1 || toDir->Find(toName) != -1 || 
+		snapshots->Shares(sector) == MaxShares)
+        success = FALSE;
+    else if (!toDir->Add(toName, sector, FALSE))
+        success = FALSE;		// no space in directory
+    else {
+        success = TRUE;
+        hdr = kernel->openFileTable->Open(sector);
+        hdr->SetLinks(hdr->Links() + 1);
+        hdr->WriteBack(sector);
+        kernel->openFileTable->Close(sector, hdr);
+        snapshots->Share(sector);	// one more name points at it
+        toDir->WriteBack(toFile);
+        snapshots->WriteBack(snapshotFile);
+    }
+    journal->End();
+    if (toDir != fromDir)
+        delete toDir;
+    delete fromDir;
+    if (toFile != rootFile)
+        delete toFile;
+    if (fromFile != rootFile)
+        delete fromFile;
+    return success;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::List
 // 	List all the files in the file system directory.
@@ -429,7 +864,7 @@ FileSystem::List(char *name, bool isRecursive)
     strncpy(filepath, name, 255);
 
     directory = new Directory(NumDirEntries);
-    dir_file = FindDirectory(filepath);
+    dir_file = FindDirectory(filepath, FALSE);
     
     // directory->FetchFrom(directoryFile);
     directory->FetchFrom(dir_file);
@@ -437,10 +872,89 @@ FileSystem::List(char *name, bool isRecursive)
     else directory->List();
 
     delete directory;
-    if (dir_file != directoryFile)
+    if (dir_file != rootFile)
         delete dir_file;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::ListLong
+// 	List the files in directory "name" with their size, type, number
+//	of names, and creation and modification times (like ls -l).
+//----------------------------------------------------------------------
+
+void
+FileSystem::ListLong(char *name)
+{
+    char filepath[256];
+    Directory *directory;
+    OpenFile *dir_file;
+
+    memset(filepath, 0, sizeof(filepath));
+    strncpy(filepath, name, 255);
+
+    dir_file = FindDirectory(filepath, FALSE);
+    if (dir_file == NULL)
+        return;
+    directory = new Directory(NumDirEntries);
+    directory->FetchFrom(dir_file);
+    directory->LongList();
+
+    delete directory;
+    if (dir_file != rootFile)
+        delete dir_file;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Stat
+// 	Fill in "info" with the attributes of file "name" (UNIX stat).
+//	Return FALSE if there is no such file.
+//
+//	The header is taken from the table of in-core headers, so asking
+//	again about the same file costs no header read -- only the
+//	directories on the way to it are read.
+//
+//	"name" -- the text name of the file, or "/" for the root
+//	"info" -- where to put the attributes
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Stat(char *name, FileInfo *info)
+{
+    Directory *directory;
+    OpenFile *dir_file;
+    FileHeader *hdr;
+    char *element_name;
+    int sector;
+
+    if (!strcmp(name, "/")) {
+        sector = rootFile->HeaderSector();
+        info->isDir = TRUE;
+    } else {
+        dir_file = FindDirectory(getDirName(name), FALSE);
+        if (dir_file == NULL)
+            return FALSE;		// parent directory not found
+        element_name = getFileName(name);
+        directory = new Directory(NumDirEntries);
+        directory->FetchFrom(dir_file);
+        sector = directory->Find(element_name);
+        if (sector != -1)
+            info->isDir = directory->IsDir(element_name);
+        delete directory;
+        if (dir_file != rootFile)
+            delete dir_file;
+        if (sector == -1)
+            return FALSE;		// file not found
+    }
+
+    hdr = kernel->openFileTable->Open(sector);
+    info->size = hdr->FileLength();
+    info->links = hdr->Links();
+    info->createTime = hdr->CreateTime();
+    info->modifyTime = hdr->ModifyTime();
+    kernel->openFileTable->Close(sector, hdr);
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // FileSystem::Print
 // 	Print everything about the file system:
@@ -478,17 +992,315 @@ FileSystem::Print()
     delete directory;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::Check
+// 	Check the consistency of the whole file system, and repair it.
+//
+//	The disk is read into memory in one sequential sweep, then every
+//	directory and file header reachable from the root, or from the
+//	root of a snapshot, is walked, counting the references to each
+//	sector.  A header or index sector reached more than once is only
+//	walked the first time, since it is shared (see snapshot.h): what
+//	it points at has one reference from it however many trees it is
+//	in; likewise for a directory's data sector and the headers its
+//	entries point at.  Directory entries and snapshots that point at
+//	a corrupt header, or into the free map, the log or the snapshot
+//	table, are removed.  A file with several names is reached once
+//	per name, and its link count must agree with the names the live
+//	tree has.
+//
+//	Finally the free map and the share counts on disk are compared
+//	with the ones the references call for.  Sectors marked in use that
+//	nobody uses have leaked; sectors someone uses that are marked free
+//	could be handed out twice; a share count that is too low would
+//	let a write change a snapshot, and one too high would leak the
+//	sector.  All are fixed by writing back the rebuilt free map and
+//	counts.  (So a sector two files use by mistake ends up shared, and
+//	whichever is written first gets a copy of its own.)
+//
+//	Return TRUE if nothing had to be repaired.
+//----------------------------------------------------------------------
+
+#define Reserved	(MaxShares + 2)	// reference count of system sectors
+
+bool
+FileSystem::Check()
+{
+    int *refs = new int[NumSectors];	// references to each sector
+    char *walked = new char[NumSectors];// how each sector was walked
+    char path[FileNameMaxLen + 2];
+    PersistentBitmap *freeMap;
+    int i, expected, badEntries, leaked = 0, unmarked = 0, miscounted = 0;
+    int badLinks = 0;
+    int used = 0;
+
+    kernel->openFileTable->Flush();
+    journal->Commit();			// check what is really on disk
+    kernel->synchDisk->LoadImage();
+
+    memset(walked, 0, NumSectors);
+    for (i = 0; i < NumSectors; i++)
+	refs[i] = 0;
+    for (i = 0; i < (int) JournalSectors; i++)
+	refs[JournalSector + i] = 1;
+    if (!CheckFile(FreeMapSector, "(free map)", refs, walked) ||
+		!CheckFile(SnapshotSector, "(snapshots)", refs, walked)) {
+	printf("fsck: root of the file system is corrupt, giving up\n");
+	kernel->synchDisk->DropImage();
+	delete [] refs;
+	delete [] walked;
+	return FALSE;
+    }
+    for (i = 0; i < NumSectors; i++)	// nobody else may point at these
+	if (refs[i] > 0)
+	    refs[i] = Reserved;
+    if (!CheckFile(DirectorySector, "/", refs, walked)) {
+	printf("fsck: root of the file system is corrupt, giving up\n");
+	kernel->synchDisk->DropImage();
+	delete [] refs;
+	delete [] walked;
+	return FALSE;
+    }
+    refs[DirectorySector] = Reserved;	// entries can't point at the root
+
+    journal->Begin();
+    checking = TRUE;			// repairs apply to every tree
+    badEntries = CheckDirectory(directoryFile, "", refs, walked);
+    for (i = 0; i < NumSectors; i++) {
+	// so far only the live tree is counted, and there the references
+	// to a header are its names
+	FileHeader *hdr;
+
+	if (walked[i] != 'h' || refs[i] == Reserved)
+	    continue;
+	hdr = kernel->openFileTable->Open(i);
+	if (hdr->Links() != refs[i]) {
+	    printf("fsck: header sector %d has %d links, but %d names\n", 
+		i, hdr->Links(), refs[i]);
+	    hdr->SetLinks(refs[i]);
+	    hdr->WriteBack(i);
+	    badLinks++;
+	}
+	kernel->openFileTable->Close(i, hdr);
+    }
+    for (i = 0; i < MaxSnapshots; i++) {
+	SnapshotEntry *snap = snapshots->Entry(i);
+	bool first;
+
+	if (!snap->inUse)
+	    continue;
+	snap->name[FileNameMaxLen] = '\0';
+	sprintf(path, "%s:", snap->name);
+	first = snap->root >= 0 && snap->root < NumSectors && !walked[snap->root];
+	if (!CheckFile(snap->root, path, refs, walked)) {
+	    printf("fsck: %s removing snapshot\n", path);
+	    snapshots->RemoveEntry(i);
+	    badEntries++;
+	} else if (first) {
+	    OpenFile *rootDir = new OpenFile(snap->root);
+	    badEntries += CheckDirectory(rootDir, path, refs, walked);
+	    delete rootDir;
+	}
+    }
+
+    freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    for (i = 0; i < NumSectors; i++) {
+	if (refs[i] > 0)
+	    used++;
+	if (refs[i] == 0 && freeMap->Test(i)) {
+	    DEBUG(dbgFile, "fsck: sector " << i << " leaked");
+	    freeMap->Clear(i);
+	    leaked++;
+	} else if (refs[i] > 0 && !freeMap->Test(i)) {
+	    DEBUG(dbgFile, "fsck: sector " << i << " in use but marked free");
+	    freeMap->Mark(i);
+	    unmarked++;
+	}
+	expected = (refs[i] == 0 || refs[i] == Reserved) ? 0 : refs[i] - 1;
+	expected = min(expected, MaxShares);
+	if (snapshots->Shares(i) != expected) {
+	    DEBUG(dbgFile, "fsck: sector " << i << " has " << refs[i] 
+		<< " references, but " << snapshots->Shares(i) << " shares");
+	    snapshots->SetShares(i, expected);
+	    miscounted++;
+	}
+    }
+    if (leaked > 0 || unmarked > 0)
+	freeMap->WriteBack(freeMapFile);
+    snapshots->WriteBack(snapshotFile);	// only if something changed
+    checking = FALSE;
+    journal->End();
+    journal->Commit();
+    kernel->synchDisk->DropImage();
+
+    printf("fsck: %d sectors in use, %d leaked, %d in use but marked free, "
+		"%d wrong share counts, %d wrong link counts, "
+		"%d bad directory entries\n", 
+		used, leaked, unmarked, miscounted, badLinks, badEntries);
+    delete freeMap;
+    delete [] refs;
+    delete [] walked;
+    return (leaked == 0 && unmarked == 0 && miscounted == 0 && 
+		badLinks == 0 && badEntries == 0);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CheckFile
+// 	Check the file header in "sector", and count one reference to it.
+//	The first time the header is reached, also count a reference to
+//	each of its index sectors, and the first time each index sector
+//	is reached, one to each of its data sectors.  Return FALSE,
+//	counting nothing, if the header is corrupt or points at a sector
+//	reserved for the system files.
+//
+//	"path" -- name of the file, for messages
+//	"refs" -- references counted so far to each sector
+//	"walked" -- 'h' or 'i' for the sectors already walked as a header
+//		or index sector, which a sector can't be both; 'd' for the
+//		data sectors of directories walked
+//----------------------------------------------------------------------
+
+bool
+FileSystem::CheckFile(int sector, const char *path, int *refs, char *walked)
+{
+    FileHeader *hdr;
+    int *sectors;
+    int i, j, n, numIdx;
+    bool ok = TRUE;
+
+    if (sector < 0 || sector >= NumSectors) {
+	printf("fsck: %s: header sector %d is off the disk\n", path, sector);
+	return FALSE;
+    }
+    if (refs[sector] == Reserved || walked[sector] == 'i') {
+	printf("fsck: %s: header sector %d belongs to another file\n", 
+		path, sector);
+	return FALSE;
+    }
+    if (walked[sector] == 'h') {
+	refs[sector]++;			// shared, and checked already
+	return TRUE;
+    }
+    hdr = new FileHeader;
+    sectors = new int[MaxHeaderSectors];
+    hdr->FetchFrom(sector);
+    if ((n = hdr->ListSectors(sectors)) < 0) {
+	printf("fsck: %s: corrupt file header in sector %d\n", path, sector);
+	ok = FALSE;
+    }
+    // the index sectors come first in the list, then the data sectors
+    numIdx = ok ? divRoundUp(divRoundUp(hdr->FileLength(), SectorSize), 
+		NumIndexEntries) : 0;
+    for (i = 0; ok && i < n; i++)
+	if (refs[sectors[i]] == Reserved || sectors[i] == sector ||
+		(i < numIdx && walked[sectors[i]] == 'h')) {
+	    printf("fsck: %s: sector %d belongs to another file\n", 
+		path, sectors[i]);
+	    ok = FALSE;
+	}
+    if (ok) {
+	refs[sector]++;
+	walked[sector] = 'h';
+	for (i = 0; i < numIdx; i++) {
+	    refs[sectors[i]]++;
+	    if (walked[sectors[i]] == 'i')
+		continue;		// shared, and counted already
+	    walked[sectors[i]] = 'i';
+	    for (j = numIdx + i * NumIndexEntries; 
+			j < min(numIdx + (i + 1) * (int)NumIndexEntries, n); j++)
+		refs[sectors[j]]++;
+	}
+    }
+    delete [] sectors;
+    delete hdr;
+    return ok;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CheckDirectory
+// 	Check every entry of a directory, and everything below it,
+//	removing the entries whose files are corrupt.  An entry points
+//	from the data sector holding its sector number, so entries in a
+//	data sector already walked through another tree are skipped, as
+//	are subdirectories walked already.  Return the number of entries
+//	removed.
+//
+//	"dirFile" -- the directory, whose header is already counted
+//	"path" -- its name, for messages ("" for the root)
+//----------------------------------------------------------------------
+
+int
+FileSystem::CheckDirectory(OpenFile *dirFile, const char *path, int *refs, 
+		char *walked)
+{
+    Directory *directory = new Directory(NumDirEntries);
+    FileHeader *hdr = dirFile->Header();
+    char name[FileNameMaxLen + 1], *child;
+    int i, pos, bad = 0;
+
+    if (dirFile->Length() != DirectoryFileSize) {
+	// CheckFile let it through, but it isn't shaped like a directory
+	printf("fsck: %s: not a directory\n", path);
+	delete directory;
+	return 0;
+    }
+    directory->FetchFrom(dirFile);
+    for (i = 0; i < directory->TableSize(); i++) {
+	DirectoryEntry *entry = directory->Entry(i);
+	bool first;
+
+	pos = (char *)&entry->sector - (char *)directory->Entry(0);
+	if (!entry->inUse || walked[hdr->ByteToSector(pos)] == 'd')
+	    continue;
+	strncpy(name, entry->name, FileNameMaxLen);
+	name[FileNameMaxLen] = '\0';
+	child = new char[strlen(path) + FileNameMaxLen + 2];
+	sprintf(child, "%s/%s", path, name);
+	first = entry->sector >= 0 && entry->sector < NumSectors && 
+		walked[entry->sector] == 0;
+	if (!CheckFile(entry->sector, child, refs, walked)) {
+	    printf("fsck: %s: removing directory entry\n", child);
+	    directory->RemoveEntry(i);
+	    bad++;
+	} else if (entry->isDir && first) {
+	    OpenFile *childFile = new OpenFile(entry->sector);
+	    bad += CheckDirectory(childFile, child, refs, walked);
+	    delete childFile;
+	}
+	delete [] child;
+    }
+    for (pos = 0; pos < (int) DirectoryFileSize; pos += SectorSize)
+	if (walked[hdr->ByteToSector(pos)] == 0)
+	    walked[hdr->ByteToSector(pos)] = 'd';
+    if (bad > 0)
+	directory->WriteBack(dirFile);
+    delete directory;
+    return bad;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindDirectory
+// 	Open the directory "name", walking down from the root (of the
+//	mounted snapshot, if there is one).  Return NULL if some part of
+//	the path isn't there or isn't a directory.
+//
+//	"unshare" -- the caller may change the directory, so give every
+//		directory on the way a header of its own (see Unshare)
+//----------------------------------------------------------------------
+
 OpenFile* 
-FileSystem::FindDirectory(char* name) { // name is path
+FileSystem::FindDirectory(char* name, bool unshare) { // name is path
     Directory *directory;
-    OpenFile *dir_file = directoryFile;
+    OpenFile *dir_file = rootFile;
     int dir_sector;
 
     char *dir_name = "/";
     char *child_dir_name;
 
+    if (unshare && !UnshareDirectory(rootFile))
+        return NULL;//disk full
     directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile); // get root dir
+    directory->FetchFrom(rootFile); // get root dir
     child_dir_name = strtok(name, dir_name); //get child directory name
     // /abc/sss/ccc => child_dir_name=abc
     // / => child_dir_name=NULL
@@ -496,19 +1308,35 @@ FileSystem::FindDirectory(char* name) { // name is path
         dir_sector = directory->Find(child_dir_name);//find child dir_name under current directory
         if (dir_sector == -1) {//if not found
             cout << "a" << endl;
-            delete dir_file;
+            if (dir_file != rootFile)
+                delete dir_file;
+            delete directory;
             return NULL;
         }
         else {//if we found the child directory
             if (directory->IsDir(child_dir_name) == FALSE) {
                 cout << child_dir_name << endl;
                 cout << "b" << endl;
-                delete dir_file;
+                if (dir_file != rootFile)
+                    delete dir_file;
+                delete directory;
                 return NULL;//not a directory
             }
-            if (dir_file != directoryFile) //prevent memory leak
+            if (unshare && 
+		(dir_sector = Unshare(directory, dir_file, child_dir_name)) == -1) {
+                if (dir_file != rootFile)
+                    delete dir_file;
+                delete directory;
+                return NULL;//disk full
+            }
+            if (dir_file != rootFile) //prevent memory leak
                 delete dir_file;
             dir_file = new OpenFile(dir_sector);
+            if (unshare && !UnshareDirectory(dir_file)) {
+                delete dir_file;
+                delete directory;
+                return NULL;//disk full
+            }
             directory->FetchFrom(dir_file);
             
             child_dir_name = strtok(NULL, dir_name);
@@ -518,6 +1346,491 @@ FileSystem::FindDirectory(char* name) { // name is path
     return dir_file;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::Unshare
+// 	Look up "name" in "directory", and return the sector of its file
+//	header, or -1 if it isn't there (or the disk is full).  If a
+//	snapshot shares the header, first give the live file system a
+//	copy of its own, and point the directory entry at it; the copy
+//	points at the same index sectors, which each gain a reference.
+//	Nothing is copied in a mounted snapshot, which is never written.
+//
+//	Each of the file's names in the live tree is a reference to its
+//	header, so it is only shared if it has more references than
+//	names.  If it has several names, they all have to move to the
+//	copy (see RedirectLinks); "directory" is then read in again.
+//
+//	"dirFile" -- the directory's file, already private (see
+//		UnshareDirectory)
+//----------------------------------------------------------------------
+
+int
+FileSystem::Unshare(Directory *directory, OpenFile *dirFile, char *name)
+{
+    PersistentBitmap *freeMap;
+    FileHeader *hdr;
+    int sector = directory->Find(name), copy, links;
+
+    if (sector == -1 || rootFile != directoryFile)
+	return sector;
+    hdr = kernel->openFileTable->Open(sector);
+    links = hdr->Links();
+    kernel->openFileTable->Close(sector, hdr);
+    if (snapshots->Shares(sector) < links)
+	return sector;			// only its own names point at it
+
+    journal->Begin();
+    freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    copy = freeMap->FindAndSet();
+    if (copy != -1) {
+	DEBUG(dbgFile, "Copying header of " << name << " from sector " 
+		<< sector << " to " << copy);
+	hdr = new FileHeader;
+	hdr->FetchFrom(sector);
+	hdr->Share(snapshots);
+	hdr->WriteBack(copy);
+	// the map goes first, since writing the directory may have to
+	// copy sectors it shares with a snapshot
+	freeMap->WriteBack(freeMapFile);
+	if (links == 1) {
+	    snapshots->Release(sector);
+	    directory->Redirect(name, copy);
+	    directory->WriteBack(dirFile);
+	} else {
+	    RedirectLinks(sector, copy, links);
+	    directory->FetchFrom(dirFile);
+	}
+	snapshots->WriteBack(snapshotFile);
+	delete hdr;
+    }
+    journal->End();
+    delete freeMap;
+    return copy;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::RedirectLinks
+// 	The live tree has a copy of its own of the header in "sector",
+//	in "copy"; point each of the file's "links" names at the copy,
+//	moving their references from the old header to the new one.
+//	Names don't know about each other, so they are found by walking
+//	the whole live tree; but only files with several names that a
+//	snapshot shares get here, and only once per snapshot.
+//----------------------------------------------------------------------
+
+void
+FileSystem::RedirectLinks(int sector, int copy, int links)
+{
+    char **paths = new char *[links];
+    int i, n = 0;
+
+    FindLinks(directoryFile, "", sector, paths, &n, links);
+    for (i = 0; i < n; i++) {
+	char *name = getFileName(paths[i]);
+	OpenFile *dirFile = FindDirectory(getDirName(paths[i]), TRUE);
+	Directory *directory;
+
+	DEBUG(dbgFile, "Pointing " << paths[i] << " at header " << copy);
+	if (dirFile == NULL) {
+	    // disk full; the name stays with the snapshot's header,
+	    // and fsck will put the link counts right
+	    delete [] paths[i];
+	    continue;
+	}
+	directory = new Directory(NumDirEntries);
+	directory->FetchFrom(dirFile);
+	directory->Redirect(name, copy);
+	directory->WriteBack(dirFile);
+	snapshots->Release(sector);
+	if (i > 0)
+	    snapshots->Share(copy);	// the copy starts with one reference
+	delete directory;
+	if (dirFile != rootFile)
+	    delete dirFile;
+	delete [] paths[i];
+    }
+    delete [] paths;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindLinks
+// 	Put the path of every name in the directory "dirFile", or below
+//	it, for the header in "sector" in "paths", counting them in "n",
+//	and stop once there are "max".
+//
+//	"path" -- the directory's name ("" for the root)
+//----------------------------------------------------------------------
+
+void
+FileSystem::FindLinks(OpenFile *dirFile, const char *path, int sector, 
+		char **paths, int *n, int max)
+{
+    Directory *directory = new Directory(NumDirEntries);
+
+    directory->FetchFrom(dirFile);
+    for (int i = 0; i < directory->TableSize() && *n < max; i++) {
+	DirectoryEntry *entry = directory->Entry(i);
+	char *child;
+
+	if (!entry->inUse)
+	    continue;
+	child = new char[strlen(path) + FileNameMaxLen + 2];
+	sprintf(child, "%s/%.*s", path, FileNameMaxLen, entry->name);
+	if (entry->sector == sector) {
+	    paths[(*n)++] = child;
+	    continue;
+	}
+	if (entry->isDir) {
+	    OpenFile *childFile = new OpenFile(entry->sector);
+	    FindLinks(childFile, child, sector, paths, n, max);
+	    delete childFile;
+	}
+	delete [] child;
+    }
+    delete directory;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::UnshareDirectory
+// 	Give the directory in "dirFile", whose header is already private,
+//	its own copy of every index and data sector it shares with a
+//	snapshot, before it is changed.  Regular files are copied a sector
+//	at a time as they are written (see CopyOnWrite), but a directory's
+//	data sectors hold the pointers to its files' headers, and those
+//	each gain a reference when the sector holding the pointer is
+//	copied; so directories are done here, where we know what they
+//	hold.  Return FALSE, changing nothing, if the disk is too full.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::UnshareDirectory(OpenFile *dirFile)
+{
+    FileHeader *hdr = dirFile->Header();
+    Directory *directory;
+    PersistentBitmap *freeMap;
+    char buf[SectorSize];
+    int offset, sector, copy, i, needed = 1;	// one for the index sector
+
+    if (rootFile != directoryFile)
+	return TRUE;			// a mounted snapshot is never written
+    for (offset = 0; offset < hdr->FileLength(); offset += SectorSize)
+	if (hdr->IsShared(offset, snapshots))
+	    needed++;
+    if (needed == 1)
+	return TRUE;			// nothing shared: the usual case
+
+    directory = new Directory(NumDirEntries);
+    directory->FetchFrom(dirFile);
+    journal->Begin();
+    freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    if (freeMap->NumClear() < needed) {
+	journal->End();
+	delete freeMap;
+	delete directory;
+	return FALSE;
+    }
+    for (offset = 0; offset < hdr->FileLength(); offset += SectorSize) {
+	if (!hdr->IsShared(offset, snapshots))
+	    continue;
+	sector = hdr->ByteToSector(offset);
+	kernel->synchDisk->ReadSector(sector, buf);
+	copy = hdr->CopyOnWrite(offset, dirFile->HeaderSector(), freeMap, 
+			snapshots);
+	ASSERT(copy != -1);
+	if (copy == sector)
+	    continue;			// only the index sector was shared
+	kernel->synchDisk->WriteSector(copy, buf);
+	for (i = 0; i < directory->TableSize(); i++) {
+	    DirectoryEntry *entry = directory->Entry(i);
+	    int pos = (char *)&entry->sector - (char *)directory->Entry(0);
+
+	    if (entry->inUse && pos / SectorSize == offset / SectorSize)
+		snapshots->Share(entry->sector);
+	}
+    }
+    freeMap->WriteBack(freeMapFile);
+    snapshots->WriteBack(snapshotFile);
+    journal->End();
+    delete freeMap;
+    delete directory;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CopyOnWrite
+// 	Return the sector OpenFile::WriteAt should write byte "offset" of
+//	a file to.  That is where the byte is now, unless a snapshot
+//	shares the sector (or its index sector), in which case the file
+//	is moved to a copy first, as one journaled operation.  Return -1
+//	if there is no room for the copy.
+//
+//	"hdr" -- the file's header, which is private to the live tree
+//	"hdrSector" -- where that header is on disk
+//----------------------------------------------------------------------
+
+int
+FileSystem::CopyOnWrite(FileHeader *hdr, int hdrSector, int offset)
+{
+    PersistentBitmap *freeMap;
+    int sector;
+
+    if (checking || !hdr->IsShared(offset, snapshots))
+	return hdr->ByteToSector(offset);
+
+    journal->Begin();
+    freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    sector = hdr->CopyOnWrite(offset, hdrSector, freeMap, snapshots);
+    if (sector != -1) {
+	freeMap->WriteBack(freeMapFile);
+	snapshots->WriteBack(snapshotFile);
+    }
+    journal->End();
+    delete freeMap;
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Snapshot
+// 	Freeze the whole directory tree, as it is now, as snapshot "name".
+//	This takes a constant amount of work however big the tree is: the
+//	root directory's header is copied, and its index sectors gain a
+//	reference; everything else is shared until the live file system
+//	changes it (see snapshot.h).
+//
+//	Return FALSE if the name is taken, the table or the disk is full,
+//	a snapshot is mounted, or some file is open.  (A file opened
+//	before the snapshot might have its sectors written in place,
+//	changing the snapshot too, so we don't allow that.)
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Snapshot(char *name)
+{
+    PersistentBitmap *freeMap;
+    FileHeader *rootHdr;
+    int sector;
+    bool success;
+
+    DEBUG(dbgFile, "Taking snapshot " << name);
+    if (rootFile != directoryFile)
+	return FALSE;
+    for (sector = 0; sector < NumSectors; sector++)
+	if (sector != FreeMapSector && sector != DirectorySector &&
+		sector != SnapshotSector && kernel->openFileTable->IsOpen(sector)) {
+	    DEBUG(dbgFile, "File with header in sector " << sector << " is open");
+	    return FALSE;
+	}
+    kernel->openFileTable->Flush();	// the snapshot gets the latest times
+
+    journal->Begin();
+    freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    sector = freeMap->FindAndSet();
+    if (sector == -1 || !snapshots->Add(name, sector))
+	success = FALSE;
+    else {
+	rootHdr = new FileHeader;
+	rootHdr->FetchFrom(DirectorySector);
+	rootHdr->Share(snapshots);
+	rootHdr->WriteBack(sector);
+	freeMap->WriteBack(freeMapFile);
+	snapshots->WriteBack(snapshotFile);
+	delete rootHdr;
+	success = TRUE;
+    }
+    journal->End();
+    delete freeMap;
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Mount
+// 	From now on, look names up in snapshot "name" instead of the live
+//	file system, which can't be changed until it is mounted again
+//	(with "name" NULL).  Return FALSE if there is no such snapshot.
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Mount(char *name)
+{
+    int sector;
+
+    if (name != NULL && (sector = snapshots->Find(name)) == -1)
+	return FALSE;
+    if (rootFile != directoryFile)
+	delete rootFile;
+    rootFile = directoryFile;
+    if (name != NULL) {
+	DEBUG(dbgFile, "Mounting snapshot " << name);
+	rootFile = new OpenFile(sector);
+	rootFile->SetReadOnly();
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ListSnapshots
+// 	Print the names of the snapshots.
+//----------------------------------------------------------------------
+
+void
+FileSystem::ListSnapshots()
+{
+    snapshots->List();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::PrintStats
+// 	Print the I/O done through each file since Nachos started, and
+//	the total for each directory and everything below it, in the
+//	style of "du": a directory comes after what is in it.  Files
+//	with no I/O are left out, and so is all of a directory nobody
+//	looked in, whose header was never read.
+//
+//	Only files whose headers are in core are counted, so the I/O of
+//	files removed since is not.
+//----------------------------------------------------------------------
+
+void
+FileSystem::PrintStats()
+{
+    FileStats total;
+    FileHeader *hdr;
+
+    printf("%9s %9s %7s %7s %6s %6s  %s\n", "bytes rd", "bytes wr", 
+	"sec rd", "sec wr", "hits", "hdr rd", "file");
+    if ((hdr = kernel->openFileTable->Cached(FreeMapSector)) != NULL) {
+	hdr->Stats()->Print("(free map)");
+	total.Add(hdr->Stats());
+    }
+    if ((hdr = kernel->openFileTable->Cached(SnapshotSector)) != NULL) {
+	hdr->Stats()->Print("(snapshots)");
+	total.Add(hdr->Stats());
+    }
+    StatsDirectory(rootFile->HeaderSector(), "", &total);
+    total.Print("(total)");
+}
+
+//----------------------------------------------------------------------
+// FileSystem::StatsDirectory
+// 	Print the I/O of every file in the directory whose header is in
+//	"sector", and below it, then the directory's own total; add that
+//	to "total".  Reading the directory to find its entries is itself
+//	I/O through it, which is taken back out.
+//
+//	"path" -- its name ("" for the root)
+//----------------------------------------------------------------------
+
+void
+FileSystem::StatsDirectory(int sector, const char *path, FileStats *total)
+{
+    FileHeader *hdr = kernel->openFileTable->Cached(sector);
+    Directory *directory;
+    OpenFile *dirFile;
+    FileStats sub, saved;
+    char *child;
+
+    if (hdr == NULL)
+	return;				// not looked in
+    saved = *hdr->Stats();
+    dirFile = new OpenFile(sector);
+    directory = new Directory(NumDirEntries);
+    directory->FetchFrom(dirFile);
+    delete dirFile;
+    *hdr->Stats() = saved;
+
+    for (int i = 0; i < directory->TableSize(); i++) {
+	DirectoryEntry *entry = directory->Entry(i);
+	FileHeader *fileHdr;
+
+	if (!entry->inUse)
+	    continue;
+	child = new char[strlen(path) + FileNameMaxLen + 2];
+	sprintf(child, "%s/%.*s", path, FileNameMaxLen, entry->name);
+	if (entry->isDir)
+	    StatsDirectory(entry->sector, child, &sub);
+	else if ((fileHdr = kernel->openFileTable->Cached(entry->sector)) 
+		!= NULL && !fileHdr->Stats()->IsZero()) {
+	    fileHdr->Stats()->Print(child);
+	    sub.Add(fileHdr->Stats());
+	}
+	delete [] child;
+    }
+    sub.Add(hdr->Stats());
+    if (!sub.IsZero())
+	sub.Print((*path == '\0') ? "/" : path);
+    total->Add(&sub);
+    delete directory;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Save
+// 	Write the disk, as the file system sees it, into a checkpoint open
+//	as host file "fd": each sector is the in-core copy of a header
+//	changed since it was written back, or else the newer copy the log
+//	holds, or else what is on disk.  Then which headers are in core,
+//	which of those were changed, and which have their index in core;
+//	and the log.
+//
+//	SynchDisk::Restore writes the sectors to disk before the file
+//	system is mounted; once it is, Restore reads the rest back, so
+//	that the same opens and lookups find what they need in core, and
+//	what was still to be written is written when it would have been.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Save(int fd)
+{
+    char data[SectorSize];
+    char cached[NumSectors], dirty[NumSectors], indexed[NumSectors];
+    FileHeader *hdr;
+
+    for (int i = 0; i < NumSectors; i++) {
+	hdr = kernel->openFileTable->Cached(i);
+	cached[i] = (hdr != NULL);
+	dirty[i] = (hdr != NULL && hdr->IsDirty());
+	indexed[i] = (hdr != NULL && hdr->HasIndex());
+	if (dirty[i])
+	    bcopy((char *) hdr, data, SectorSize);
+	else if (!journal->Lookup(i, data))
+	    kernel->synchDisk->Peek(i, data);
+	WriteFile(fd, data, SectorSize);
+    }
+    WriteFile(fd, cached, NumSectors);
+    WriteFile(fd, dirty, NumSectors);
+    WriteFile(fd, indexed, NumSectors);
+    journal->Save(fd);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Restore
+// 	Read back what Save wrote after the sectors, once mounted: bring
+//	the same headers into core as were (mounting read some already),
+//	in the same state, and restore the log.  The disk time this takes
+//	doesn't count: the clock is set back to the checkpoint's later.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Restore(int fd)
+{
+    char cached[NumSectors], dirty[NumSectors], indexed[NumSectors];
+    FileHeader *hdr;
+
+    Read(fd, cached, NumSectors);
+    Read(fd, dirty, NumSectors);
+    Read(fd, indexed, NumSectors);
+    for (int i = 0; i < NumSectors; i++) {
+	if (!cached[i]) {
+	    ASSERT(!kernel->openFileTable->IsOpen(i));
+	    kernel->openFileTable->Forget(i);
+	    continue;
+	}
+	hdr = kernel->openFileTable->Open(i);	// stays cached
+	kernel->openFileTable->Close(i, hdr);
+	hdr->Restore(dirty[i], indexed[i]);
+    }
+    journal->Restore(fd);
+}
+
 char* FileSystem::getDirName(char* path) {
     char* dirc, *dname;
     char *filepath = new char[256];
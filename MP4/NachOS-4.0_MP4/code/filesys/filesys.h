@@ -38,6 +38,12 @@
 #include "openfile.h"
 #include "directory.h"
 
+class Journal;
+class SnapshotTable;
+class FileHeader;
+class FileStats;
+class PersistentBitmap;
+
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
 				// calls to UNIX, until the real file system
 				// implementation is available
@@ -67,6 +73,19 @@ class FileSystem {
 };
 
 #else // FILESYS
+
+// What Stat finds out about a file.  All of it is kept in the file
+// header, except whether the file is a directory, which its directory
+// entry says.
+
+class FileInfo {
+  public:
+    int size;				// in bytes
+    bool isDir;
+    int links;				// number of names the file has
+    int createTime, modifyTime;		// in ticks
+};
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -85,37 +104,72 @@ class FileSystem {
     OpenFile* Open(char *name); 	// Open a file (UNIX open)
 
     bool Remove(char *name);  		// Delete a file (UNIX unlink)
+    bool RemoveTree(char *name);	// Delete a directory and everything
+					// in it (UNIX rm -r)
+
+    bool Rename(char *from, char *to);	// Move a file to a new name
+    bool Link(char *from, char *to);	// Give a file a second name
 
     void List(char *name, bool isRecursive);			// List all the files in the file system
+    void ListLong(char *name);		// List them with their attributes
+    bool Stat(char *name, FileInfo *info);
+					// Attributes of file "name"; FALSE
+					// if there is no such file
 
     void Print();			// List all the files and their contents
-	
-	int CloseFile(int id)
-	{
-		currentfile = NULL;
-		return 1;
-	}
 
-	int WriteFile(char *buffer, int size, int id)
-	{
-		return currentfile->Write(buffer, size);
-	}
+    bool Check();			// Check the disk for leaked, doubly
+					// allocated and dangling sectors,
+					// and repair it; TRUE if it was
+					// already consistent
 
-	int ReadFile(char *buffer, int size, int id)
-	{
-		return currentfile->Read(buffer, size);
-	}
+    bool Snapshot(char *name);		// Freeze the whole tree as "name"
+    bool Mount(char *name);		// Look names up in snapshot "name",
+					// read-only; NULL for the live tree
+    void ListSnapshots();		// Print the snapshot names
+
+    void PrintStats();			// Print the I/O done through each
+					// file, and each directory's total
 
-	OpenFile* FindDirectory(char* name);
+    void Save(int fd);			// Write the disk as we see it, and
+					// the log, into a checkpoint
+    void Restore(int fd);		// Read back the rest, once mounted
+					// (SynchDisk restores the disk)
+
+    int CopyOnWrite(FileHeader *hdr, int hdrSector, int offset);
+					// Sector to write byte "offset" of
+					// a file to, copying it first if a
+					// snapshot shares it; -1 if full
+
+	OpenFile* FindDirectory(char* name, bool unshare);
 	char* getDirName(char* path);
 	char* getFileName(char* path);
 
   private:
+   bool CheckFile(int sector, const char *path, int *refs, char *walked);
+   int CheckDirectory(OpenFile *dirFile, const char *path, int *refs, char *walked);
+   int Unshare(Directory *directory, OpenFile *dirFile, char *name);
+   bool UnshareDirectory(OpenFile *dirFile);
+   void RedirectLinks(int sector, int copy, int links);
+   void DropFile(int sector, bool isDir, PersistentBitmap *freeMap);
+   void FindMultiLinks(int sector, char *path, char **paths, int *n);
+   void FindLinks(OpenFile *dirFile, const char *path, int sector,
+		char **paths, int *n, int max);
+   void StatsDirectory(int sector, const char *path, FileStats *total);
+
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
-   OpenFile* currentfile;
+   OpenFile* rootFile;			// Where names are looked up: the
+					// root directory, or the root of
+					// the mounted snapshot
+   OpenFile* snapshotFile;		// Snapshots and sector share counts,
+					// represented as a file
+   SnapshotTable* snapshots;		// Its contents, kept in memory
+   Journal* journal;			// Commits metadata updates in groups
+   bool checking;			// Check is repairing; write shared
+					// sectors in place
 };
 
 #endif // FILESYS
@@ -0,0 +1,310 @@
+// journal.cc
+//	Routines to log file system metadata updates, commit them in
+//	groups, and replay the log after a crash.  See journal.h.
+//
+//	The log descriptor is two sectors.  The second one (only needed
+//	when a group logs more sectors than fit in the first) is written
+//	before the first, and the first one holds the magic number and
+//	the count, so writing the first sector is the commit point of
+//	the whole group.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "journal.h"
+#include "synchdisk.h"
+#include "debug.h"
+#include "main.h"
+
+#define DescWords	((JournalDescSectors * SectorSize) / sizeof(int))
+#define SectorWords	(SectorSize / sizeof(int))
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize the log.  Must be called after "synchDisk" has been
+//	initialized, and before the journal is handed to it.
+//
+//	"format" -- the disk is being formatted, so just write an
+//		empty descriptor; otherwise replay whatever was
+//		committed but not yet checkpointed.
+//----------------------------------------------------------------------
+
+Journal::Journal(bool format)
+{
+    numPending = 0;
+    pending = new char[JournalSlots * SectorSize];
+    activeOps = 0;
+    groupOps = 0;
+    committing = FALSE;
+    mapFile = NULL;
+    liveMap = NULL;
+
+    if (format) {
+	int desc[SectorWords];
+
+	memset(desc, 0, sizeof(desc));
+	kernel->synchDisk->WriteSector(JournalSector, (char *)desc);
+    } else {
+	Replay();
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	Commit any pending updates, so that nothing is lost at shutdown.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    Commit();
+    delete liveMap;
+    delete [] pending;
+}
+
+//----------------------------------------------------------------------
+// Journal::Mount
+// 	Read the committed free map.  Until this is called, every write
+//	made by an operation is logged.
+//
+//	"freeMapFile" -- the open free map file, left open while Nachos
+//		is running
+//----------------------------------------------------------------------
+
+void
+Journal::Mount(OpenFile *freeMapFile)
+{
+    mapFile = freeMapFile;
+    liveMap = new PersistentBitmap(mapFile, NumSectors);
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start a file system operation.  Until the matching End, every
+//	write to a live sector is held in the log.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    activeOps++;
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	Finish a file system operation.  The group is committed once it
+//	has GroupCommitOps operations, or once another operation might
+//	not fit in the log.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    ASSERT(activeOps > 0);
+    activeOps--;
+    groupOps++;
+    if (activeOps == 0 && (groupOps >= GroupCommitOps ||
+		numPending > (int)JournalSlots - JournalReserve))
+	Commit();
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Write the pending sectors to the log, then the descriptor (after
+//	which the group survives a crash), then copy the sectors to their
+//	home locations and clear the descriptor.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    int desc[DescWords];
+    int i;
+
+    if (numPending == 0) {
+	groupOps = 0;
+	return;
+    }
+    DEBUG(dbgFile, "Committing " << numPending << " sectors for "
+		<< groupOps << " operations");
+
+    // the free map being committed is what decides which sectors are
+    // live from now on; read it while the pending copy is still here
+    if (liveMap != NULL)
+	liveMap->FetchFrom(mapFile);
+
+    committing = TRUE;
+    for (i = 0; i < numPending; i++)
+	kernel->synchDisk->WriteSector(JournalSector + JournalDescSectors + i,
+		&pending[i * SectorSize]);
+
+    memset(desc, 0, sizeof(desc));
+    desc[0] = JournalMagic;
+    desc[1] = numPending;
+    for (i = 0; i < numPending; i++)
+	desc[2 + i] = home[i];
+    for (i = JournalDescSectors - 1; i >= 0; i--)
+	if (i == 0 || numPending > (int)(i * SectorWords) - 2)
+	    kernel->synchDisk->WriteSector(JournalSector + i,
+		(char *)&desc[i * SectorWords]);
+
+    for (i = 0; i < numPending; i++)
+	kernel->synchDisk->WriteSector(home[i], &pending[i * SectorSize]);
+
+    memset(desc, 0, SectorSize);
+    kernel->synchDisk->WriteSector(JournalSector, (char *)desc);
+    committing = FALSE;
+
+    numPending = 0;
+    groupOps = 0;
+}
+
+//----------------------------------------------------------------------
+// Journal::Absorb
+// 	Decide whether a sector write goes into the log.  It does if an
+//	older copy is already pending (so the newest data is what gets
+//	checkpointed), or if an operation is in progress and the sector
+//	is live in the committed file system.
+//
+//	If the log is full, the write goes straight to disk; the
+//	operation then loses its atomicity, but nothing is lost.
+//
+//	"sector" -- the sector being written
+//	"data" -- its new contents
+//----------------------------------------------------------------------
+
+bool
+Journal::Absorb(int sector, char *data)
+{
+    int slot;
+
+    if (committing)
+	return FALSE;
+    if ((slot = Find(sector)) >= 0) {
+	bcopy(data, &pending[slot * SectorSize], SectorSize);
+	return TRUE;
+    }
+    if (activeOps == 0)
+	return FALSE;			// file data
+    if (liveMap != NULL && !liveMap->Test(sector))
+	return FALSE;			// not reachable until we commit
+    if (numPending == (int)JournalSlots) {
+	DEBUG(dbgFile, "Log full, writing sector " << sector << " in place");
+	return FALSE;
+    }
+    home[numPending] = sector;
+    bcopy(data, &pending[numPending * SectorSize], SectorSize);
+    numPending++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Lookup
+// 	If "sector" has a pending update, copy it into "data" and
+//	return TRUE; the disk copy is out of date.
+//----------------------------------------------------------------------
+
+bool
+Journal::Lookup(int sector, char *data)
+{
+    int slot = Find(sector);
+
+    if (slot < 0)
+	return FALSE;
+    bcopy(&pending[slot * SectorSize], data, SectorSize);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::Save
+// 	Write the updates pending for the next commit, how many operations
+//	it has, and which sectors were live at the last one, into a
+//	checkpoint open as host file "fd".  No operation may be under way.
+//----------------------------------------------------------------------
+
+void
+Journal::Save(int fd)
+{
+    char live[NumSectors];
+
+    ASSERT(activeOps == 0 && !committing);
+    WriteFile(fd, (char *) &numPending, sizeof(int));
+    WriteFile(fd, (char *) home, numPending * sizeof(int));
+    WriteFile(fd, pending, numPending * SectorSize);
+    WriteFile(fd, (char *) &groupOps, sizeof(int));
+    for (int i = 0; i < NumSectors; i++)
+	live[i] = liveMap->Test(i);
+    WriteFile(fd, live, NumSectors);
+}
+
+//----------------------------------------------------------------------
+// Journal::Restore
+// 	Read back what Save wrote, once the file system is mounted.  The
+//	pending sectors are already on disk, as SynchDisk restored them;
+//	they will be written again, through the log, when the group is
+//	committed, as they would have been.
+//----------------------------------------------------------------------
+
+void
+Journal::Restore(int fd)
+{
+    char live[NumSectors];
+
+    Read(fd, (char *) &numPending, sizeof(int));
+    Read(fd, (char *) home, numPending * sizeof(int));
+    Read(fd, pending, numPending * SectorSize);
+    Read(fd, (char *) &groupOps, sizeof(int));
+    Read(fd, live, NumSectors);
+    for (int i = 0; i < NumSectors; i++) {
+	if (live[i])
+	    liveMap->Mark(i);
+	else
+	    liveMap->Clear(i);
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::Find
+// 	Return the log slot holding "sector", or -1 if it isn't pending.
+//----------------------------------------------------------------------
+
+int
+Journal::Find(int sector)
+{
+    for (int i = 0; i < numPending; i++)
+	if (home[i] == sector)
+	    return i;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Journal::Replay
+// 	If the descriptor says a group was committed, copy its sectors
+//	from the log to their homes (again -- this is harmless if some
+//	of them made it before the crash), then clear the descriptor.
+//----------------------------------------------------------------------
+
+void
+Journal::Replay()
+{
+    int desc[DescWords];
+    char *data = new char[SectorSize];
+    int i, count;
+
+    for (i = 0; i < JournalDescSectors; i++)
+	kernel->synchDisk->ReadSector(JournalSector + i,
+		(char *)&desc[i * SectorWords]);
+    count = desc[1];
+    if (desc[0] == JournalMagic && count > 0 && count <= (int)JournalSlots) {
+	DEBUG(dbgFile, "Replaying " << count << " logged sectors");
+	for (i = 0; i < count; i++) {
+	    kernel->synchDisk->ReadSector(JournalSector + JournalDescSectors + i,
+			data);
+	    kernel->synchDisk->WriteSector(desc[2 + i], data);
+	}
+	memset(desc, 0, SectorSize);
+	kernel->synchDisk->WriteSector(JournalSector, (char *)desc);
+    }
+    delete [] data;
+}
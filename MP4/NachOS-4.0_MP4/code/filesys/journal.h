@@ -0,0 +1,86 @@
+// journal.h
+//	Data structures for a write-ahead log of file system metadata.
+//
+//	Metadata updates (free map, directory and file header sectors)
+//	made by a file system operation are held in memory instead of
+//	being written in place.  The updates of several operations are
+//	committed together: they are appended to a log region on disk,
+//	a descriptor naming their home sectors is written (the commit
+//	point), and only then are they copied to their home sectors
+//	(the checkpoint).  If Nachos dies before the checkpoint is done,
+//	the log is replayed the next time the disk is mounted, so each
+//	operation is either entirely on disk or not at all.
+//
+//	Sectors that are free in the last committed free map can't be
+//	reached from committed metadata, so writes to them (new file
+//	headers, index sectors and file data) go straight to disk.  Only
+//	overwrites of live sectors -- typically the free map and the
+//	parent directory, shared by a whole group of operations -- are
+//	logged, which is where group commit saves writes.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "disk.h"
+#include "pbitmap.h"
+
+// Layout of the log region, reserved in the free map at format time.
+// The descriptor holds a magic number, the number of logged sectors,
+// and the home sector of each; the logged sectors follow it.
+#define JournalSector		2	// first sector of the log region
+#define JournalDescSectors	2	// sectors in the log descriptor
+#define JournalSlots		((JournalDescSectors * SectorSize) / sizeof(int) - 2)
+#define JournalSectors		(JournalDescSectors + JournalSlots)
+
+#define JournalMagic		0x4a524e4c	// descriptor is valid
+#define GroupCommitOps		8	// commit after this many operations
+#define JournalReserve		52	// most sectors one operation can log
+
+class Journal {
+  public:
+    Journal(bool format);		// Initialize the log region if
+					// "format", otherwise replay any
+					// committed but unfinished log
+    ~Journal();				// Commit anything still pending
+
+    void Mount(OpenFile *freeMapFile);	// Start tracking which sectors
+					// are live, using the free map
+
+    void Begin();			// Start a file system operation
+    void End();				// Finish one; commit the group if
+					// it is big enough
+
+    void Commit();			// Log, checkpoint and forget every
+					// pending update
+
+    bool Absorb(int sector, char *data);// Called by SynchDisk on every
+					// write; TRUE if the log took it
+    bool Lookup(int sector, char *data);// Called by SynchDisk on every
+					// read; TRUE if a newer copy of
+					// the sector is pending
+
+    void Save(int fd);			// Write the pending updates into a
+    void Restore(int fd);		// checkpoint, or read them back
+
+  private:
+    void Replay();			// Finish a committed log after a crash
+    int Find(int sector);		// Slot holding "sector", or -1
+
+    int numPending;			// number of pending sectors
+    int home[JournalSlots];		// home sector of each pending sector
+    char *pending;			// their contents, SectorSize each
+    int activeOps;			// operations between Begin and End
+    int groupOps;			// operations since the last commit
+    bool committing;			// our own writes go straight to disk
+
+    OpenFile *mapFile;			// the free map, NULL until Mount
+    PersistentBitmap *liveMap;		// free map as of the last commit
+};
+
+#endif // JOURNAL_H
@@ -5,7 +5,8 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open.  There is one in-core copy of each
+//	header, shared by all the opens of the file (see OpenFileTable).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -21,16 +22,17 @@
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open, unless it is there already.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr = kernel->openFileTable->Open(sector);
+    hdrSector = sector;
     seekPosition = 0;
+    readOnly = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -40,7 +42,7 @@ OpenFile::OpenFile(int sector)
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    kernel->openFileTable->Close(hdrSector, hdr);
 }
 
 //----------------------------------------------------------------------
@@ -96,14 +98,21 @@ OpenFile::Write(char *into, int numBytes)
 //	boundary; however the disk only knows how to read/write a whole disk
 //	sector at a time.  Thus:
 //
+//	Whole sectors in the middle of the request are transferred straight
+//	between the disk and the caller's buffer.  Only a partial sector at
+//	either end goes through a one-sector bounce buffer on the stack:
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   We read the sector in, but only copy the part we are interested in.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   We must first read in the sector, so that we don't overwrite the
+//	   unmodified portion (unless that portion is all past the end of
+//	   the file).  We then copy in the data that will be modified, and
+//	   write the sector back.
+//
+//	A sector WriteAt is about to write may be shared with a snapshot;
+//	the file system then moves it to a fresh sector first (see
+//	snapshot.h).  WriteAt stops early if that fails for lack of space,
+//	and writes nothing at all to a read-only file.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -116,28 +125,28 @@ int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int done, offset, amount, sector;
+    char buf[SectorSize];
 
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
     if ((position + numBytes) > fileLength)		
 	numBytes = fileLength - position;
     DEBUG(dbgFile, "Reading " << numBytes << " bytes at " << position << " from file of length " << fileLength);
+    hdr->Stats()->bytesRead += numBytes;
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    for (done = 0; done < numBytes; done += amount) {
+	sector = hdr->ByteToSector(position + done);
+	offset = (position + done) % SectorSize;
+	amount = min(SectorSize - offset, numBytes - done);
+	hdr->Stats()->sectorsRead++;
+	if (amount == SectorSize)
+	    kernel->synchDisk->ReadSector(sector, &into[done]);
+	else {
+	    kernel->synchDisk->ReadSector(sector, buf);
+	    bcopy(&buf[offset], &into[done], amount);
+	}
+    }
     return numBytes;
 }
 
@@ -145,43 +154,40 @@ int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int done, offset, amount, sector;
+    char buf[SectorSize];
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position >= fileLength) || readOnly)
 	return 0;				// check request
     if ((position + numBytes) > fileLength)
 	numBytes = fileLength - position;
     DEBUG(dbgFile, "Writing " << numBytes << " bytes at " << position << " from file of length " << fileLength);
+    hdr->Stats()->bytesWritten += numBytes;
+    hdr->Touch();
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    buf = new char[numSectors * SectorSize];
-	
-	// Mp4 mod tag
-	memset(buf, 0, sizeof(char) * numSectors * SectorSize); // dummy operation to keep valgrind happy
-
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
-
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
-
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
-
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+    for (done = 0; done < numBytes; done += amount) {
+	sector = hdr->ByteToSector(position + done);
+	offset = (position + done) % SectorSize;
+	amount = min(SectorSize - offset, numBytes - done);
+	if (amount < SectorSize) {
+	    // keep the rest of the sector, unless all of it is past the
+	    // end of the file
+	    if (offset > 0 || (position + done + amount) < fileLength) {
+		kernel->synchDisk->ReadSector(sector, buf);
+		hdr->Stats()->sectorsRead++;
+	    } else
+		memset(buf, 0, SectorSize);	// keep valgrind happy
+	    bcopy(&from[done], &buf[offset], amount);
+	}
+	// no file system yet while it is being formatted, and so
+	// nothing shared
+	if (kernel->fileSystem != NULL && (sector = 
+		kernel->fileSystem->CopyOnWrite(hdr, hdrSector, position + done)) == -1)
+	    return done;			// disk full
+	kernel->synchDisk->WriteSector(sector, 
+		(amount == SectorSize) ? &from[done] : buf);
+	hdr->Stats()->sectorsWritten++;
+    }
     return numBytes;
 }
 
@@ -196,4 +202,130 @@ OpenFile::Length()
     return hdr->FileLength(); 
 }
 
+//----------------------------------------------------------------------
+// OpenFileTable::OpenFileTable
+// 	Initialize an empty table of in-core file headers, with room for
+//	a header in every sector of the disk.
+//----------------------------------------------------------------------
+
+OpenFileTable::OpenFileTable()
+{
+    headers = new FileHeader *[NumSectors];
+    for (int i = 0; i < NumSectors; i++)
+	headers[i] = NULL;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::~OpenFileTable
+// 	Free every cached header.  Files still open at shutdown keep
+//	theirs until their OpenFile is deleted.
+//----------------------------------------------------------------------
+
+OpenFileTable::~OpenFileTable()
+{
+    for (int i = 0; i < NumSectors; i++)
+	Forget(i);
+    delete [] headers;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Open
+// 	Return the in-core header of the file whose header is at
+//	"sector", reading it from disk if it isn't cached, and count
+//	the caller as one more opener.
+//----------------------------------------------------------------------
+
+FileHeader *
+OpenFileTable::Open(int sector)
+{
+    FileHeader *hdr = headers[sector];
+
+    if (hdr == NULL) {
+	hdr = new FileHeader;
+	hdr->FetchFrom(sector);
+	headers[sector] = hdr;
+    } else
+	hdr->Stats()->cacheHits++;
+    hdr->refCount++;
+    return hdr;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Close
+// 	Drop a reference taken by Open.  The header stays cached, unless
+//	its file has been removed, in which case the last closer frees it.
+//	The last closer also writes back a modification time that the
+//	file's writers only changed in core.
+//----------------------------------------------------------------------
+
+void
+OpenFileTable::Close(int sector, FileHeader *hdr)
+{
+    ASSERT(hdr->refCount > 0);
+    hdr->refCount--;
+    if (hdr->refCount > 0)
+	return;
+    if (headers[sector] != hdr)
+	delete hdr;
+    else if (hdr->IsDirty())
+	hdr->WriteBack(sector);
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Flush
+// 	Write back every cached header whose modification time changed
+//	in core, even if the file is still open.  Called before the
+//	headers on disk have to be up to date: at shutdown, and before
+//	a snapshot or a check.
+//----------------------------------------------------------------------
+
+void
+OpenFileTable::Flush()
+{
+    for (int i = 0; i < NumSectors; i++)
+	if (headers[i] != NULL && headers[i]->IsDirty())
+	    headers[i]->WriteBack(i);
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::IsOpen
+// 	Return TRUE if some OpenFile is using the header at "sector".
+//----------------------------------------------------------------------
+
+bool
+OpenFileTable::IsOpen(int sector)
+{
+    return headers[sector] != NULL && headers[sector]->refCount > 0;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Cached
+// 	Return the in-core header at "sector", or NULL if it has not been
+//	read in (so no I/O has been done through the file).  Unlike Open,
+//	this neither reads the disk nor counts an opener.
+//----------------------------------------------------------------------
+
+FileHeader *
+OpenFileTable::Cached(int sector)
+{
+    return headers[sector];
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Forget
+// 	The file whose header was at "sector" has been removed, so the
+//	sector may soon hold some other file's header.  Drop the cached
+//	copy; anyone who still has the file open keeps using it.
+//----------------------------------------------------------------------
+
+void
+OpenFileTable::Forget(int sector)
+{
+    FileHeader *hdr = headers[sector];
+
+    headers[sector] = NULL;
+    if (hdr != NULL && hdr->refCount == 0)
+	delete hdr;
+}
+
 #endif //FILESYS_STUB
@@ -86,10 +86,55 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+
+    int HeaderSector() { return hdrSector; }
+					// Where the header lives, so the
+					// file can be opened again
+    FileHeader *Header() { return hdr; }
+
+    void SetReadOnly() { readOnly = TRUE; }
+					// Refuse writes from now on (the
+					// file is in a snapshot)
+    bool IsReadOnly() { return readOnly; }
     
   private:
-    FileHeader *hdr;			// Header for this file 
+    FileHeader *hdr;			// Header for this file, shared 
+					// with every other open of it
+    int hdrSector;			// Where the header lives on disk
     int seekPosition;			// Current position within the file
+    bool readOnly;			// Writes return 0
+};
+
+// The following class defines the system-wide table of in-core file
+// headers.  Every OpenFile of the same file shares the one header
+// found here (each keeping its own seek position), so opening a file
+// that is already open, or was open recently, needs no disk read, and
+// a change to the header is seen by every opener at once.
+//
+// Headers stay cached after their last close, until the file is
+// removed; so does the count of I/O done through the file.
+
+class OpenFileTable {
+  public:
+    OpenFileTable();			// Initialize an empty table
+    ~OpenFileTable();			// Free every cached header
+
+    FileHeader *Open(int sector);	// Return the header at "sector",
+					// reading it in if it isn't cached,
+					// and count one more reference
+    void Close(int sector, FileHeader *hdr);
+					// Drop a reference taken by Open
+    void Flush();			// Write back the headers changed
+					// in core
+    void Forget(int sector);		// The file at "sector" is gone; its
+					// header lives on only until its
+					// remaining openers close it
+    bool IsOpen(int sector);		// Does anyone have "sector" open?
+    FileHeader *Cached(int sector);	// The header at "sector" if it is
+					// in core, else NULL
+
+  private:
+    FileHeader **headers;		// cached header of each sector, or NULL
 };
 
 #endif // FILESYS
@@ -77,3 +77,32 @@ PersistentBitmap::WriteBack(OpenFile *file)
 {
    file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
 }
+
+//----------------------------------------------------------------------
+// PersistentBitmap::FindAndSetRun
+// 	Find the first run of "count" consecutive clear bits, and mark
+//	them all as in use.  Used to lay a file's data out contiguously
+//	on disk, so that it can be transferred in one sequential sweep.
+//
+//	Return the number of the first bit in the run, or -1 if there
+//	is no run that long (the caller can then fall back to FindAndSet).
+//----------------------------------------------------------------------
+
+int
+PersistentBitmap::FindAndSetRun(int count)
+{
+    int start, i;
+
+    if (count <= 0)
+	return -1;
+    for (start = 0; start + count <= numBits; start = i + 1) {
+	for (i = start; i < start + count && !Test(i); i++)
+	    ;
+	if (i == start + count) {
+	    for (i = start; i < start + count; i++)
+		Mark(i);
+	    return start;
+	}
+    }
+    return -1;
+}
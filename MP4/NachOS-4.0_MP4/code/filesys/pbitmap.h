@@ -30,6 +30,11 @@ class PersistentBitmap : public Bitmap {
 
     void FetchFrom(OpenFile *file);     // read bitmap from the disk
     void WriteBack(OpenFile *file); 	// write bitmap contents to disk 
+
+    int FindAndSetRun(int count);	// Return the first of "count" 
+					// consecutive clear bits, and set 
+					// them all.  -1 if there is no 
+					// such run.
 };
 
 #endif // PBITMAP_H
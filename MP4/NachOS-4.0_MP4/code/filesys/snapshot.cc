@@ -0,0 +1,195 @@
+// snapshot.cc
+//	Routines to manage the table of snapshots and the share count of
+//	every sector.  See snapshot.h; the copying itself is done by the
+//	file system (filesys.cc) and the file header (filehdr.cc).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "utility.h"
+#include "debug.h"
+#include "snapshot.h"
+
+#define TableBytes	(sizeof(SnapshotEntry) * MaxSnapshots)
+
+//----------------------------------------------------------------------
+// SnapshotTable::SnapshotTable
+// 	Initialize an empty table: no snapshots, and no sector shared.
+//	When the disk is formatted, this is all we need; otherwise call
+//	FetchFrom.
+//----------------------------------------------------------------------
+
+SnapshotTable::SnapshotTable()
+{
+    memset(table, 0, sizeof(table));	// keep valgrind happy
+    for (int i = 0; i < MaxSnapshots; i++)
+	table[i].inUse = FALSE;
+    shares = new unsigned char[NumSectors];
+    memset(shares, 0, NumSectors);
+    tableDirty = TRUE;			// never been written
+    firstDirty = 0;
+    lastDirty = NumSectors - 1;
+}
+
+//----------------------------------------------------------------------
+// SnapshotTable::~SnapshotTable
+//----------------------------------------------------------------------
+
+SnapshotTable::~SnapshotTable()
+{
+    delete [] shares;
+}
+
+//----------------------------------------------------------------------
+// SnapshotTable::FetchFrom
+// 	Read the table and the share counts from disk.
+//
+//	"file" -- the snapshot table file
+//----------------------------------------------------------------------
+
+void
+SnapshotTable::FetchFrom(OpenFile *file)
+{
+    (void) file->ReadAt((char *)table, TableBytes, 0);
+    (void) file->ReadAt((char *)shares, NumSectors, TableBytes);
+    tableDirty = FALSE;
+    firstDirty = NumSectors;
+    lastDirty = -1;
+}
+
+//----------------------------------------------------------------------
+// SnapshotTable::WriteBack
+// 	Write the parts changed since the last FetchFrom/WriteBack back
+//	to disk.  An operation usually changes the counts of a few
+//	sectors that are close together, so one sector of counts is
+//	written; taking a snapshot adds the table.
+//
+//	"file" -- the snapshot table file
+//----------------------------------------------------------------------
+
+void
+SnapshotTable::WriteBack(OpenFile *file)
+{
+    if (tableDirty)
+	(void) file->WriteAt((char *)table, TableBytes, 0);
+    if (firstDirty <= lastDirty)
+	(void) file->WriteAt((char *)&shares[firstDirty],
+		lastDirty - firstDirty + 1, TableBytes + firstDirty);
+    tableDirty = FALSE;
+    firstDirty = NumSectors;
+    lastDirty = -1;
+}
+
+//----------------------------------------------------------------------
+// SnapshotTable::Add
+// 	Record a snapshot called "name", whose root directory header is
+//	in sector "root".  Return FALSE if there already is a snapshot
+//	with that name, or if the table is full.
+//----------------------------------------------------------------------
+
+bool
+SnapshotTable::Add(char *name, int root)
+{
+    if (Find(name) != -1)
+	return FALSE;
+    for (int i = 0; i < MaxSnapshots; i++)
+	if (!table[i].inUse) {
+	    table[i].inUse = TRUE;
+	    table[i].root = root;
+	    strncpy(table[i].name, name, FileNameMaxLen);
+	    table[i].name[FileNameMaxLen] = '\0';
+	    tableDirty = TRUE;
+	    return TRUE;
+	}
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// SnapshotTable::Find
+// 	Return the sector holding the root directory header of snapshot
+//	"name", or -1 if there is no such snapshot.
+//----------------------------------------------------------------------
+
+int
+SnapshotTable::Find(char *name)
+{
+    for (int i = 0; i < MaxSnapshots; i++)
+	if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
+	    return table[i].root;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// SnapshotTable::RemoveEntry
+// 	Forget snapshot "i".  Used by the consistency checker when the
+//	snapshot's root is corrupt; its sectors are then reclaimed.
+//----------------------------------------------------------------------
+
+void
+SnapshotTable::RemoveEntry(int i)
+{
+    ASSERT(i >= 0 && i < MaxSnapshots);
+    table[i].inUse = FALSE;
+    tableDirty = TRUE;
+}
+
+//----------------------------------------------------------------------
+// SnapshotTable::List
+// 	Print the names of the snapshots.
+//----------------------------------------------------------------------
+
+void
+SnapshotTable::List()
+{
+    for (int i = 0; i < MaxSnapshots; i++)
+	if (table[i].inUse)
+	    printf("%s\n", table[i].name);
+}
+
+//----------------------------------------------------------------------
+// SnapshotTable::Share
+// 	Count one more reference to "sector", which is already in use.
+//----------------------------------------------------------------------
+
+void
+SnapshotTable::Share(int sector)
+{
+    ASSERT(sector >= 0 && sector < NumSectors);
+    ASSERT(shares[sector] < MaxShares);
+    SetShares(sector, shares[sector] + 1);
+}
+
+//----------------------------------------------------------------------
+// SnapshotTable::Release
+// 	Drop a reference to "sector".  If it was shared, someone else
+//	still uses it: drop one share and return TRUE.  Otherwise return
+//	FALSE, and the caller, who held the only reference, frees it.
+//----------------------------------------------------------------------
+
+bool
+SnapshotTable::Release(int sector)
+{
+    ASSERT(sector >= 0 && sector < NumSectors);
+    if (shares[sector] == 0)
+	return FALSE;
+    SetShares(sector, shares[sector] - 1);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// SnapshotTable::SetShares
+// 	Set the number of extra references to "sector" to "count".
+//----------------------------------------------------------------------
+
+void
+SnapshotTable::SetShares(int sector, int count)
+{
+    ASSERT(count >= 0 && count <= MaxShares);
+    if (shares[sector] == count)
+	return;
+    shares[sector] = count;
+    firstDirty = min(firstDirty, sector);
+    lastDirty = max(lastDirty, sector);
+}
@@ -0,0 +1,95 @@
+// snapshot.h
+//	Data structures for copy-on-write snapshots of the file system.
+//
+//	A snapshot is a frozen copy of the whole directory tree, which can
+//	later be mounted read-only.  Taking one copies nothing but the
+//	root directory's file header; everything below it is shared by
+//	the live tree and the snapshot.
+//
+//	To know what is shared, every sector has a reference count: the
+//	number of file headers, index sectors and directory entries that
+//	point at it (a snapshot's root is pointed at by the table below).
+//	The free map still says whether a sector is in use at all, so all
+//	we store is the number of *extra* references, the "shares"; a
+//	sector nobody else uses has none.
+//
+//	Counts are pushed down lazily, as in a copy-on-write B-tree: when
+//	the live tree is about to change a shared sector, it makes its own
+//	copy, drops its reference to the original, and adds a reference to
+//	every sector the copy points at.  So a sector can only be changed
+//	in place if neither it nor anything on the path to it is shared.
+//	The file system makes that path private from the top down: file
+//	headers as names are looked up (FileSystem::Unshare), then a whole
+//	directory at once before it is changed, since its data sectors
+//	point at headers (FileSystem::UnshareDirectory), and the index and
+//	data sectors of a file as they are written (FileSystem::CopyOnWrite).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "disk.h"
+#include "journal.h"
+#include "directory.h"
+
+// The snapshot table is a file whose header is in the first sector
+// after the log region, so that it can be found on boot-up.
+#define SnapshotSector		(JournalSector + JournalSectors)
+#define MaxSnapshots		8
+#define MaxShares		255	// most extra references to a sector
+
+// One snapshot: its name, and the header of its root directory.
+
+class SnapshotEntry {
+  public:
+    bool inUse;				// Is this entry in use?
+    int root;				// Header of the frozen root directory
+    char name[FileNameMaxLen + 1];	// Name of the snapshot
+};
+
+#define SnapshotFileSize	(sizeof(SnapshotEntry) * MaxSnapshots + NumSectors)
+
+// The table of snapshots, followed by the share count of every sector.
+// Kept in memory while Nachos is running; like Directory, only the
+// parts changed since the last FetchFrom/WriteBack are written back.
+
+class SnapshotTable {
+  public:
+    SnapshotTable();			// No snapshots, nothing shared
+    ~SnapshotTable();
+
+    void FetchFrom(OpenFile *file);	// Read the table from disk
+    void WriteBack(OpenFile *file);	// Write the changed parts back
+
+    bool Add(char *name, int root);	// Record a new snapshot; FALSE if
+					// the name is taken or no room
+    int Find(char *name);		// Root of snapshot "name", or -1
+    SnapshotEntry *Entry(int i) { return &table[i]; }
+					// Entry "i", for the checker
+    void RemoveEntry(int i);		// Forget entry "i"
+    void List();			// Print the snapshot names
+
+    int Shares(int sector) { return shares[sector]; }
+					// Extra references to "sector"
+    void Share(int sector);		// Add a reference to "sector"
+    bool Release(int sector);		// Drop one; FALSE if there were
+					// none, so the caller should free
+					// the sector
+    void SetShares(int sector, int count);
+					// Set the count, for the checker
+
+  private:
+    SnapshotEntry table[MaxSnapshots];	// The snapshots
+    unsigned char *shares;		// shares[s] is the number of extra
+					// references to sector s
+    bool tableDirty;			// table changed since last written
+    int firstDirty, lastDirty;		// range of shares changed since
+					// last written; first > last if none
+};
+
+#endif // SNAPSHOT_H
@@ -16,6 +16,7 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "journal.h"
 
 
 //----------------------------------------------------------------------
@@ -30,6 +31,8 @@ SynchDisk::SynchDisk()
     semaphore = new Semaphore("synch disk", 0);
     lock = new Lock("synch disk lock");
     disk = new Disk(this);
+    journal = NULL;
+    image = NULL;
 }
 
 //----------------------------------------------------------------------
@@ -40,6 +43,7 @@ SynchDisk::SynchDisk()
 
 SynchDisk::~SynchDisk()
 {
+    delete [] image;
     delete disk;
     delete lock;
     delete semaphore;
@@ -52,11 +56,20 @@ SynchDisk::~SynchDisk()
 //
 //	"sectorNumber" -- the disk sector to read
 //	"data" -- the buffer to hold the contents of the disk sector
+//
+//	If the journal holds a newer copy of the sector, that is
+//	returned without going to the disk.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
+    if (journal != NULL && journal->Lookup(sectorNumber, data))
+	return;
+    if (image != NULL) {
+	bcopy(&image[sectorNumber * SectorSize], data, SectorSize);
+	return;
+    }
     lock->Acquire();			// only one disk I/O at a time
     disk->ReadRequest(sectorNumber, data);
     semaphore->P();			// wait for interrupt
@@ -70,17 +83,74 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 //
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
+//
+//	The journal may take the write instead, to commit it later.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
+    if (journal != NULL && journal->Absorb(sectorNumber, data))
+	return;
+    if (image != NULL)
+	bcopy(data, &image[sectorNumber * SectorSize], SectorSize);
     lock->Acquire();			// only one disk I/O at a time
     disk->WriteRequest(sectorNumber, data);
     semaphore->P();			// wait for interrupt
     lock->Release();
 }
 
+//----------------------------------------------------------------------
+// SynchDisk::LoadImage
+// 	Read every sector of the disk, in order, into memory.  Until
+//	DropImage is called, reads are served from this copy (writes
+//	still go to the disk, and update the copy).
+//
+//	Walking many files this way costs one sequential sweep of the
+//	disk, instead of a seek for every header and data sector.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::LoadImage()
+{
+    char *copy = new char[NumSectors * SectorSize];
+
+    DropImage();
+    for (int i = 0; i < NumSectors; i++)
+	ReadSector(i, &copy[i * SectorSize]);
+    image = copy;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::DropImage
+// 	Forget the in-memory copy of the disk made by LoadImage.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::DropImage()
+{
+    delete [] image;
+    image = NULL;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Restore
+// 	Read every sector of the disk from a checkpoint open as host file
+//	"fd", and write it to the disk directly, before the file system
+//	is mounted.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Restore(int fd)
+{
+    char data[SectorSize];
+
+    for (int i = 0; i < NumSectors; i++) {
+	Read(fd, data, SectorSize);
+	disk->Poke(i, data);
+    }
+}
+
 //----------------------------------------------------------------------
 // SynchDisk::CallBack
 // 	Disk interrupt handler.  Wake up any thread waiting for the disk
@@ -15,6 +15,8 @@
 #include "synch.h"
 #include "callback.h"
 
+class Journal;
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -40,6 +42,25 @@ class SynchDisk : public CallBackObj {
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
     
+    void LoadImage();			// Read the whole disk, in order,
+					// into memory; reads are then
+					// served from that copy
+    void DropImage();			// Go back to reading the disk
+
+    void Peek(int sectorNumber, char* data) 
+		{ disk->Peek(sectorNumber, data); }
+					// Read a sector, taking no time
+    void Restore(int fd);		// Write the sectors of a checkpoint
+					// (see FileSystem::Save) to disk
+    void SaveHead(int fd) { disk->Save(fd); }
+    void RestoreHead(int fd) { disk->Restore(fd); }
+					// Where the disk head is, into a
+					// checkpoint or back
+
+    void SetJournal(Journal *j) { journal = j; }
+					// Route metadata writes through
+					// the log (NULL to stop)
+
     void CallBack();			// Called by the disk device interrupt
 					// handler, to signal that the
 					// current disk operation is complete.
@@ -50,6 +71,9 @@ class SynchDisk : public CallBackObj {
 					// with the interrupt handler
     Lock *lock;		  		// Only one read/write request
 					// can be sent to the disk at a time
+    Journal *journal;			// Holds pending metadata updates,
+					// or NULL
+    char *image;			// Copy of the whole disk, or NULL
 };
 
 #endif // SYNCHDISK_H
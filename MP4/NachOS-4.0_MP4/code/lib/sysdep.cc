@@ -50,6 +50,8 @@
 extern "C" {
 #include <signal.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
 
 #ifndef NO_MPROT 
 #include <sys/mman.h>
@@ -420,6 +422,57 @@ Unlink(char *name)
     return unlink(name);
 }
 
+//----------------------------------------------------------------------
+// OpenDir
+// 	Open a UNIX directory for reading its entries.  Returns NULL 
+//	if the directory can't be opened.
+//----------------------------------------------------------------------
+
+void *
+OpenDir(char *name)
+{
+    return (void *) opendir(name);
+}
+
+//----------------------------------------------------------------------
+// ReadDir
+// 	Return the name of the next entry in an open UNIX directory,
+//	or NULL when there are no more.  The name is only valid until
+//	the next call.
+//----------------------------------------------------------------------
+
+char *
+ReadDir(void *dir)
+{
+    struct dirent *entry = readdir((DIR *) dir);
+
+    return (entry == NULL) ? NULL : entry->d_name;
+}
+
+//----------------------------------------------------------------------
+// CloseDir
+// 	Close a directory opened with OpenDir.
+//----------------------------------------------------------------------
+
+void
+CloseDir(void *dir)
+{
+    (void) closedir((DIR *) dir);
+}
+
+//----------------------------------------------------------------------
+// IsDirectory
+// 	Is the UNIX file "name" a directory?
+//----------------------------------------------------------------------
+
+bool
+IsDirectory(char *name)
+{
+    struct stat st;
+
+    return (stat(name, &st) == 0) && S_ISDIR(st.st_mode);
+}
+
 //----------------------------------------------------------------------
 // OpenSocket
 // 	Open an interprocess communication (IPC) connection.  For now, 
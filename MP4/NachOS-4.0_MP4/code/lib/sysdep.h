@@ -53,6 +53,12 @@ extern int Tell(int fd);
 extern int Close(int fd);
 extern bool Unlink(char *name);
 
+// Directory operations, for importing a UNIX directory tree
+extern void *OpenDir(char *name);	// NULL if "name" can't be opened
+extern char *ReadDir(void *dir);	// next entry name, NULL at the end
+extern void CloseDir(void *dir);
+extern bool IsDirectory(char *name);
+
 // Other C library routines that are used by Nachos.
 // These are assumed to be portable, so we don't include a wrapper.
 extern "C" {
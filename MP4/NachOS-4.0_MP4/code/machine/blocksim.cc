@@ -0,0 +1,608 @@
+// blocksim.cc -- run user programs as threaded code
+//
+//   The alternative to the instruction-at-a-time interpreter in
+//   mipssim.cc: basic blocks are translated into arrays of operations
+//   (see blocksim.h), and a whole block runs per dispatch.  The common
+//   instructions have routines of their own here, which must do exactly
+//   what Machine::Execute does for them; the rest are handed to
+//   Machine::Execute.
+//
+//   Simulated time is exactly what the interpreter would produce.  A
+//   block only runs if no interrupt falls due before its last
+//   instruction, so none can be missed; its ticks are then added all
+//   at once.  Close to an interrupt, we step one instruction at a time,
+//   just like the interpreter.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "debug.h"
+#include "machine.h"
+#include "mipsops.h"
+#include "blocksim.h"
+#include "main.h"
+#include "profile.h"
+#include "checkpoint.h"
+
+//----------------------------------------------------------------------
+// Finish
+// 	Finish an instruction the way Machine::Execute does: do the
+//	delayed load of the previous instruction, record this one's, and
+//	advance the program counters.
+//----------------------------------------------------------------------
+
+static inline bool
+Finish(int *r, int loadReg, int loadValue, int pcAfter)
+{
+    r[r[LoadReg]] = r[LoadValueReg];
+    r[LoadReg] = loadReg;
+    r[LoadValueReg] = loadValue;
+    r[0] = 0;
+    r[PrevPCReg] = r[PCReg];
+    r[PCReg] = r[NextPCReg];
+    r[NextPCReg] = pcAfter;
+    return TRUE;
+}
+
+#define NEXT(r)		((r)[NextPCReg] + 4)
+#define TARGET(r, in)	((r)[NextPCReg] + IndexToAddr((in)->extra))
+
+//----------------------------------------------------------------------
+// GenericOp
+// 	Execute any instruction, through the interpreter.
+//----------------------------------------------------------------------
+
+bool
+GenericOp(Machine *machine, int *r, BlockOp *op)
+{
+    return machine->Execute(&op->instr);
+}
+
+// The instructions that have routines of their own.  Each one is a
+// copy of its case in Machine::Execute.
+
+static bool
+OpADDIU(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rt] = r[(int) in->rs] + in->extra;
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpADDU(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rd] = r[(int) in->rs] + r[(int) in->rt];
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpSUBU(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rd] = r[(int) in->rs] - r[(int) in->rt];
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpAND(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rd] = r[(int) in->rs] & r[(int) in->rt];
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpANDI(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rt] = r[(int) in->rs] & (in->extra & 0xffff);
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpOR(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rd] = r[(int) in->rs] | r[(int) in->rt];
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpORI(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rt] = r[(int) in->rs] | (in->extra & 0xffff);
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpXOR(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rd] = r[(int) in->rs] ^ r[(int) in->rt];
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpXORI(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rt] = r[(int) in->rs] ^ (in->extra & 0xffff);
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpNOR(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rd] = ~(r[(int) in->rs] | r[(int) in->rt]);
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpLUI(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rt] = in->extra << 16;
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpSLL(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rd] = r[(int) in->rt] << in->extra;
+    return Finish(r, 0, 0, pcAfter);
+}
+
+// Machine::Execute shifts an int for both SRA and SRL, so they are the
+// same here too.
+
+static bool
+OpSRA(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rd] = r[(int) in->rt] >> in->extra;
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpSLT(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rd] = (r[(int) in->rs] < r[(int) in->rt]) ? 1 : 0;
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpSLTI(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rt] = (r[(int) in->rs] < in->extra) ? 1 : 0;
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpSLTU(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rd] = ((unsigned int) r[(int) in->rs] < (unsigned int) r[(int) in->rt]) ? 1 : 0;
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpSLTIU(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    r[(int) in->rt] = ((unsigned int) r[(int) in->rs] < (unsigned int) in->extra) ? 1 : 0;
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpMFHI(Machine *machine, int *r, BlockOp *op)
+{
+    int pcAfter = NEXT(r);
+
+    r[(int) op->instr.rd] = r[HiReg];
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpMFLO(Machine *machine, int *r, BlockOp *op)
+{
+    int pcAfter = NEXT(r);
+
+    r[(int) op->instr.rd] = r[LoReg];
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpBEQ(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+
+    return Finish(r, 0, 0, (r[(int) in->rs] == r[(int) in->rt]) ? TARGET(r, in) : NEXT(r));
+}
+
+static bool
+OpBNE(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+
+    return Finish(r, 0, 0, (r[(int) in->rs] != r[(int) in->rt]) ? TARGET(r, in) : NEXT(r));
+}
+
+static bool
+OpBLEZ(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+
+    return Finish(r, 0, 0, (r[(int) in->rs] <= 0) ? TARGET(r, in) : NEXT(r));
+}
+
+static bool
+OpBGTZ(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+
+    return Finish(r, 0, 0, (r[(int) in->rs] > 0) ? TARGET(r, in) : NEXT(r));
+}
+
+static bool
+OpBLTZ(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+
+    return Finish(r, 0, 0, (r[(int) in->rs] & SIGN_BIT) ? TARGET(r, in) : NEXT(r));
+}
+
+static bool
+OpBGEZ(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+
+    return Finish(r, 0, 0, !(r[(int) in->rs] & SIGN_BIT) ? TARGET(r, in) : NEXT(r));
+}
+
+static bool
+OpJ(Machine *machine, int *r, BlockOp *op)
+{
+    int pcAfter = NEXT(r);
+
+    return Finish(r, 0, 0,
+		(pcAfter & 0xf0000000) | IndexToAddr(op->instr.extra));
+}
+
+static bool
+OpJAL(Machine *machine, int *r, BlockOp *op)
+{
+    int pcAfter = NEXT(r);
+
+    r[R31] = r[NextPCReg] + 4;
+    return Finish(r, 0, 0,
+		(pcAfter & 0xf0000000) | IndexToAddr(op->instr.extra));
+}
+
+static bool
+OpJR(Machine *machine, int *r, BlockOp *op)
+{
+    return Finish(r, 0, 0, r[(int) op->instr.rs]);
+}
+
+static bool
+OpJALR(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+
+    r[(int) in->rd] = r[NextPCReg] + 4;
+    return Finish(r, 0, 0, r[(int) in->rs]);
+}
+
+// Loads and stores go through ReadMem and WriteMem (or ReadWord and
+// WriteWord), which check the alignment and raise the same exceptions
+// Machine::Execute would.
+
+static bool
+OpLW(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+    int value;
+
+    if (!machine->ReadWord(r[(int) in->rs] + in->extra, &value))
+	return FALSE;
+    return Finish(r, in->rt, value, pcAfter);
+}
+
+static bool
+OpLB(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+    int value;
+
+    if (!machine->ReadMem(r[(int) in->rs] + in->extra, 1, &value))
+	return FALSE;
+    if ((value & 0x80) && (in->opCode == OP_LB))
+	value |= 0xffffff00;
+    else
+	value &= 0xff;
+    return Finish(r, in->rt, value, pcAfter);
+}
+
+static bool
+OpSW(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    if (!machine->WriteWord((unsigned) (r[(int) in->rs] + in->extra), r[(int) in->rt]))
+	return FALSE;
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static bool
+OpSB(Machine *machine, int *r, BlockOp *op)
+{
+    Instruction *in = &op->instr;
+    int pcAfter = NEXT(r);
+
+    if (!machine->WriteMem((unsigned) (r[(int) in->rs] + in->extra), 1, r[(int) in->rt]))
+	return FALSE;
+    return Finish(r, 0, 0, pcAfter);
+}
+
+static OpHandler handlers[MaxOpcode + 1];	// routine for each opcode
+
+//----------------------------------------------------------------------
+// InitHandlers
+// 	Fill in the routine for each opcode, the first time a block
+//	cache is made.
+//----------------------------------------------------------------------
+
+static void
+InitHandlers()
+{
+    if (handlers[0] != NULL)
+	return;
+    for (int i = 0; i <= MaxOpcode; i++)
+	handlers[i] = GenericOp;
+    handlers[OP_ADDIU] = OpADDIU;	handlers[OP_ADDU] = OpADDU;
+    handlers[OP_SUBU] = OpSUBU;		handlers[OP_AND] = OpAND;
+    handlers[OP_ANDI] = OpANDI;		handlers[OP_OR] = OpOR;
+    handlers[OP_ORI] = OpORI;		handlers[OP_XOR] = OpXOR;
+    handlers[OP_XORI] = OpXORI;		handlers[OP_NOR] = OpNOR;
+    handlers[OP_LUI] = OpLUI;		handlers[OP_SLL] = OpSLL;
+    handlers[OP_SRA] = OpSRA;		handlers[OP_SRL] = OpSRA;
+    handlers[OP_SLT] = OpSLT;		handlers[OP_SLTI] = OpSLTI;
+    handlers[OP_SLTU] = OpSLTU;		handlers[OP_SLTIU] = OpSLTIU;
+    handlers[OP_MFHI] = OpMFHI;		handlers[OP_MFLO] = OpMFLO;
+    handlers[OP_BEQ] = OpBEQ;		handlers[OP_BNE] = OpBNE;
+    handlers[OP_BLEZ] = OpBLEZ;		handlers[OP_BGTZ] = OpBGTZ;
+    handlers[OP_BLTZ] = OpBLTZ;		handlers[OP_BGEZ] = OpBGEZ;
+    handlers[OP_J] = OpJ;		handlers[OP_JAL] = OpJAL;
+    handlers[OP_JR] = OpJR;		handlers[OP_JALR] = OpJALR;
+    handlers[OP_LW] = OpLW;		handlers[OP_LB] = OpLB;
+    handlers[OP_LBU] = OpLB;		handlers[OP_SW] = OpSW;
+    handlers[OP_SB] = OpSB;
+}
+
+//----------------------------------------------------------------------
+// IsBranch, EndsBlock
+// 	Return TRUE if a block ends after "opCode": it changes the flow
+//	of control (after its delay slot), or it always traps.
+//----------------------------------------------------------------------
+
+static bool
+IsBranch(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BNE: case OP_BLEZ: case OP_BGTZ:
+      case OP_BLTZ: case OP_BGEZ: case OP_BLTZAL: case OP_BGEZAL:
+      case OP_J: case OP_JAL: case OP_JR: case OP_JALR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+static bool
+EndsBlock(int opCode)
+{
+    return opCode == OP_SYSCALL || opCode == OP_RES || opCode == OP_UNIMP;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::BlockCache
+// 	Initialize an empty cache of translated blocks.
+//----------------------------------------------------------------------
+
+BlockCache::BlockCache()
+{
+    InitHandlers();
+    blocks = new Block[NumBlocks];
+    for (int i = 0; i < NumBlocks; i++)
+	blocks[i].physAddr = -1;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::~BlockCache
+//----------------------------------------------------------------------
+
+BlockCache::~BlockCache()
+{
+    delete [] blocks;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Find
+// 	Return the translated block starting at "physAddr" in "memory".
+//	If its slot holds another block, or the code at "physAddr" has
+//	changed since it was translated, translate it now.  (Later
+//	instructions of the block are checked as it runs.)
+//----------------------------------------------------------------------
+
+Block *
+BlockCache::Find(char *memory, int physAddr)
+{
+    Block *block = &blocks[(physAddr / 4) % NumBlocks];
+
+    if (block->physAddr != physAddr ||
+	    block->ops[0].word != *(unsigned int *) &memory[physAddr])
+	Translate(block, memory, physAddr);
+    return block;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Translate
+// 	Translate the basic block starting at "physAddr" into "block".
+//	It ends after a branch and its delay slot, at an instruction that
+//	always traps, at the end of the page (the next virtual page may be
+//	anywhere in memory), or when it has MaxBlockLength instructions.
+//----------------------------------------------------------------------
+
+void
+BlockCache::Translate(Block *block, char *memory, int physAddr)
+{
+    int addr = physAddr;
+    int n = 0, last = MaxBlockLength;
+    BlockOp *op;
+
+    DEBUG(dbgMach, "Translating block at physical address " << physAddr);
+    block->physAddr = physAddr;
+    do {
+	op = &block->ops[n++];
+	op->word = *(unsigned int *) &memory[addr];
+	op->instr.value = WordToHost(op->word);
+	op->instr.Decode();
+	op->handler = handlers[(int) op->instr.opCode];
+	addr += 4;
+	if (IsBranch(op->instr.opCode))
+	    last = min(last, n + 1);	// include the delay slot
+	else if (EndsBlock(op->instr.opCode))
+	    break;
+    } while (n < last && (addr % PageSize) != 0);
+    block->length = n;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlocks
+// 	Simulate the execution of a user-level program as threaded code.
+//	Never returns.  The result is exactly that of the loop in
+//	Machine::Run, one block at a time.
+//
+//	A block is only run if it starts a fresh instruction stream (we
+//	aren't in a delay slot) and no interrupt is due before it ends.
+//	Otherwise we step one instruction, as Machine::Run does.
+//
+//	While a block runs, "blockPC" is where it started, so that an
+//	exception in the middle of it can first account for the time of
+//	the instructions before (see EndBlock).
+//
+//	Profile samples don't stop a block: one that falls due inside it is
+//	taken after it, which is soon enough.  Nor do checkpoints.
+//----------------------------------------------------------------------
+
+void
+Machine::RunBlocks()
+{
+    Statistics *stats = kernel->stats;
+    Block *block;
+    BlockOp *op;
+    int physAddr, due, i;
+    unsigned int *word;
+
+    for (;;) {
+	if (kernel->profiler != NULL && 
+		stats->totalTicks >= kernel->profiler->NextSample())
+	    kernel->profiler->Sample();
+	if (kernel->checkpoint != NULL && 
+		stats->totalTicks >= kernel->checkpoint->NextCheckpoint())
+	    kernel->checkpoint->Take();
+	if (registers[NextPCReg] != registers[PCReg] + 4) {
+	    OneInstruction();		// in a delay slot
+	    kernel->interrupt->OneTick();
+	    continue;
+	}
+	if (!FetchAddress(registers[PCReg], &physAddr)) {
+	    kernel->interrupt->OneTick();	// the fetch raised an exception
+	    continue;
+	}
+	block = blocks->Find(mainMemory, physAddr);
+	due = kernel->interrupt->NextDue();
+	if (due >= 0 && stats->totalTicks + block->length * UserTick >= due) {
+	    OneInstruction();		// an interrupt is due in the block
+	    kernel->interrupt->OneTick();
+	    continue;
+	}
+
+	blockPC = registers[PCReg];
+	word = (unsigned int *) &mainMemory[physAddr];
+	for (i = 0, op = block->ops; i < block->length; i++, op++) {
+	    if (word[i] != op->word)
+		break;			// overwritten since translated
+	    if (!(*op->handler)(this, registers, op))
+		break;			// exception, time already counted
+	}
+	if (blockPC == -1)		// exception
+	    kernel->interrupt->OneTick();
+	else
+	    EndBlock(i);
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::EndBlock
+// 	The block being run stops after "done" instructions.  Advance
+//	simulated time for them, as if each had ended in OneTick (none of
+//	which could have found an interrupt due).
+//----------------------------------------------------------------------
+
+void
+Machine::EndBlock(int done)
+{
+    kernel->stats->totalTicks += done * UserTick;
+    kernel->stats->userTicks += done * UserTick;
+    blockPC = -1;
+}
@@ -0,0 +1,78 @@
+// blocksim.h
+//	Data structures for the threaded-code engine, the alternative to
+//	running user programs one instruction at a time (mipssim.cc).
+//
+//	A basic block of user code -- the instructions from some address
+//	up to a jump or branch and its delay slot, a system call, or the
+//	end of the page -- is translated once into an array of operations,
+//	each holding its decoded operands and a pointer to the routine
+//	that executes it.  Running the block is then a loop of indirect
+//	calls (direct-threaded dispatch): no fetch, no decoding, no switch,
+//	and simulated time is advanced once for the whole block.
+//
+//	Blocks are found by the physical address of their first
+//	instruction.  Like the decoded instructions of the interpreter,
+//	each operation remembers the word it was translated from, and is
+//	only run while memory still holds that word.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef BLOCKSIM_H
+#define BLOCKSIM_H
+
+#include "copyright.h"
+#include "machine.h"
+
+#define MaxBlockLength	32	// most instructions in a block
+#define NumBlocks	1024	// blocks kept translated
+
+// The routine executing one operation.  It returns FALSE if the
+// instruction raised an exception (so the block has to stop).
+
+class BlockOp;
+typedef bool (*OpHandler)(Machine *machine, int *registers, BlockOp *op);
+
+// One translated instruction.
+
+class BlockOp {
+  public:
+    OpHandler handler;		// executes it
+    unsigned int word;		// the instruction, as it was in memory
+    Instruction instr;		// and decoded
+};
+
+// A translated basic block.
+
+class Block {
+  public:
+    int physAddr;		// where it starts in mainMemory; -1 if
+				// this slot is empty
+    int length;			// number of operations
+    BlockOp ops[MaxBlockLength];
+};
+
+// The translated blocks, in a direct-mapped table: a block can only
+// be in the slot its address hashes to, and pushes out whatever was
+// there.
+
+class BlockCache {
+  public:
+    BlockCache();
+    ~BlockCache();
+
+    Block *Find(char *memory, int physAddr);
+				// The block starting at "physAddr",
+				// translated now if it wasn't, or
+				// if the code there has changed
+
+  private:
+    void Translate(Block *block, char *memory, int physAddr);
+
+    Block *blocks;		// NumBlocks slots
+};
+
+#endif // BLOCKSIM_H
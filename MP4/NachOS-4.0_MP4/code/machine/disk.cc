@@ -162,6 +162,58 @@ Disk::CallBack ()
     callWhenDone->CallBack();
 }
 
+//----------------------------------------------------------------------
+// Disk::Peek/Poke
+// 	Read or write a sector of the disk's UNIX file directly: no time
+//	passes, the head doesn't move, and nothing is counted.  Only for
+//	saving and restoring the contents of the disk with a checkpoint
+//	of the machine.
+//----------------------------------------------------------------------
+
+void
+Disk::Peek(int sectorNumber, char* data)
+{
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+    Read(fileno, data, SectorSize);
+}
+
+void
+Disk::Poke(int sectorNumber, char* data)
+{
+    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+    WriteFile(fileno, data, SectorSize);
+}
+
+//----------------------------------------------------------------------
+// Disk::Save
+// 	Write where the head is, and what the track buffer holds, into a
+//	checkpoint open as host file "fd"; they decide how long the next
+//	request takes.  There must be no request in progress.
+//----------------------------------------------------------------------
+
+void
+Disk::Save(int fd)
+{
+    ASSERT(!active);
+    WriteFile(fd, (char *) &lastSector, sizeof(int));
+    WriteFile(fd, (char *) &bufferInit, sizeof(int));
+}
+
+//----------------------------------------------------------------------
+// Disk::Restore
+// 	Read back what Save wrote.
+//----------------------------------------------------------------------
+
+void
+Disk::Restore(int fd)
+{
+    ASSERT(!active);
+    Read(fd, (char *) &lastSector, sizeof(int));
+    Read(fd, (char *) &bufferInit, sizeof(int));
+}
+
 //----------------------------------------------------------------------
 // Disk::TimeToSeek()
 //	Returns how long it will take to position the disk head over the correct
@@ -70,6 +70,13 @@ class Disk : public CallBackObj {
     void CallBack();			// Invoked when disk request 
 					// finishes. In turn calls, callWhenDone.
 
+    void Peek(int sectorNumber, char* data);
+    void Poke(int sectorNumber, char* data);
+					// Read/write a sector at once, taking
+					// no time: for checkpoints only
+    void Save(int fd);			// Write where the head is into a
+    void Restore(int fd);		// checkpoint, or read it back
+
     int ComputeLatency(int newSector, bool writing);	
     					// Return how long a request to 
 					// newSector will take: 
@@ -23,6 +23,7 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "main.h"
+#include "sysdep.h"
 
 // String definitions for debugging messages
 
@@ -154,6 +155,7 @@ Interrupt::OneTick()
     if (status == SystemMode) {
         stats->totalTicks += SystemTick;
 	stats->systemTicks += SystemTick;
+	stats->cpuSystemTicks[kernel->machine->cpu] += SystemTick;
     } else {
 	stats->totalTicks += UserTick;
 	stats->userTicks += UserTick;
@@ -170,7 +172,9 @@ Interrupt::OneTick()
     				// for a context switch, ok to do it now
 	yieldOnReturn = FALSE;
  	status = SystemMode;		// yield is a kernel routine
+	kernel->currentThread->preempted = (oldStatus == UserMode);
 	kernel->currentThread->Yield();
+	kernel->currentThread->preempted = FALSE;
 	status = oldStatus;
     }
 }
@@ -242,8 +246,6 @@ Interrupt::Halt()
     cout << "This is halt\n";
     kernel->stats->Print();
 	*/
-	delete debug;
-	
     delete kernel;	// Never returns.
 }
 
@@ -282,6 +284,107 @@ Interrupt::Schedule(CallBackObj *toCall, int fromNow, IntType type)
     pending->Insert(toOccur);
 }
 
+//----------------------------------------------------------------------
+// Interrupt::NextDue
+// 	Return the time at which the next pending interrupt is due, or -1
+//	if nothing is pending.  Until then, OneTick has nothing to do but
+//	advance the time.
+//----------------------------------------------------------------------
+
+int
+Interrupt::NextDue()
+{
+    if (pending->IsEmpty())
+	return -1;
+    return pending->Front()->when;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Quiet
+// 	Return TRUE if a checkpoint of the machine can be taken now,
+//	between two user instructions: no interrupt is due, no handler
+//	asked for a context switch on return, and the only
+//	interrupts pending are those a machine just booted has too -- the
+//	timer's, and the console's polling for input.  Any other means a
+//	device is busy, and someone is waiting for it.
+//----------------------------------------------------------------------
+
+bool
+Interrupt::Quiet()
+{
+    ListIterator<PendingInterrupt *> iter(pending);
+    int timers = 0, polls = 0;
+
+    if (yieldOnReturn || (!pending->IsEmpty() && 
+		pending->Front()->when <= kernel->stats->totalTicks))
+	return FALSE;
+    for (; !iter.IsDone(); iter.Next()) {
+	if (iter.Item()->type == TimerInt)
+	    timers++;
+	else if (iter.Item()->type == ConsoleReadInt)
+	    polls++;
+	else
+	    return FALSE;
+    }
+    return timers <= 1 && polls <= 1;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Save
+// 	Write the type of each pending interrupt, and when it is due, in
+//	order, to the checkpoint open as host file "fd".
+//----------------------------------------------------------------------
+
+void
+Interrupt::Save(int fd)
+{
+    ListIterator<PendingInterrupt *> iter(pending);
+    int n = pending->NumInList();
+
+    WriteFile(fd, (char *) &n, sizeof(int));
+    for (; !iter.IsDone(); iter.Next()) {
+	WriteFile(fd, (char *) &iter.Item()->type, sizeof(IntType));
+	WriteFile(fd, (char *) &iter.Item()->when, sizeof(int));
+    }
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Restore
+// 	Read back what Save wrote.  The devices have just been started,
+//	and each has the interrupts it always has pending; those the
+//	checkpoint has are given the time it says, in its order, and the
+//	others dropped (the device had stopped).
+//----------------------------------------------------------------------
+
+void
+Interrupt::Restore(int fd)
+{
+    List<PendingInterrupt *> *fresh = new List<PendingInterrupt *>;
+    PendingInterrupt *next;
+    IntType type;
+    int n, when;
+
+    while (!pending->IsEmpty())
+	fresh->Append(pending->RemoveFront());
+    Read(fd, (char *) &n, sizeof(int));
+    for (int i = 0; i < n; i++) {
+	Read(fd, (char *) &type, sizeof(IntType));
+	Read(fd, (char *) &when, sizeof(int));
+	next = NULL;
+	for (ListIterator<PendingInterrupt *> iter(fresh); 
+		next == NULL && !iter.IsDone(); iter.Next())
+	    if (iter.Item()->type == type)
+		next = iter.Item();
+	ASSERT(next != NULL);
+	fresh->Remove(next);
+	next->when = when;
+	pending->Insert(next);
+    }
+    while (!fresh->IsEmpty())
+	delete fresh->RemoveFront();
+    delete fresh;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::CheckIfDue
 // 	Check if any interrupts are scheduled to occur, and if so, 
@@ -121,6 +121,16 @@ class Interrupt {
     
     void OneTick();       	// Advance simulated time
 
+    int NextDue();		// When the next pending interrupt is
+				// due; -1 if there is none
+
+    bool Quiet();		// Nothing is due, and no device is
+				// busy; a checkpoint can be taken
+    void Save(int fd);		// Write when each pending interrupt
+				// is due into a checkpoint
+    void Restore(int fd);	// Make the pending interrupts those
+				// of a checkpoint
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
     SortedList<PendingInterrupt *> *pending;		
@@ -142,6 +152,9 @@ class Interrupt {
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 			IntStatus now); // simulated time
+
+    friend class Scheduler;	// switches processors, which takes
+				// no time; calls ChangeLevel
 };
 
 #endif // INTERRRUPT_H
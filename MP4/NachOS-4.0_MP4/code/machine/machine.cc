@@ -9,7 +9,10 @@
 
 #include "copyright.h"
 #include "machine.h"
+#include "blocksim.h"
+#include "tlbsim.h"
 #include "main.h"
+#include "profile.h"
 
 // Textual names of the exceptions that can be generated by user program
 // execution, for debugging.
@@ -44,32 +47,84 @@ void CheckEndian()
 #endif
 }
 
+int PageSize = DefaultPageSize;
+int NumPhysPages = DefaultNumPhysPages;
+int MemorySize = DefaultNumPhysPages * DefaultPageSize;
+
+//----------------------------------------------------------------------
+// SetMemorySize
+// 	Set the page size to "pageSize" bytes, and the size of physical
+//	memory to "memorySize" bytes, which must be a whole number of
+//	pages.  Pages hold whole instructions, so their size must be a
+//	multiple of 4.  Called before the Machine is created, since it
+//	sizes mainMemory (and address spaces size their page tables) by
+//	these.
+//----------------------------------------------------------------------
+
+void
+SetMemorySize(int pageSize, int memorySize)
+{
+    ASSERT(pageSize >= 4 && pageSize % 4 == 0);
+    ASSERT(memorySize >= pageSize && memorySize % pageSize == 0);
+    PageSize = pageSize;
+    NumPhysPages = memorySize / pageSize;
+    MemorySize = memorySize;
+}
+
 //----------------------------------------------------------------------
 // Machine::Machine
 // 	Initialize the simulation of user program execution.
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"threaded" -- if TRUE, run user programs as threaded code, a block
+//		at a time (see blocksim.cc), rather than interpret them.
+//	"numCPUs" -- how many processors there are; processor 0 runs
+//		first.
+//	"useTLBs" -- if not NULL, each processor translates addresses
+//		through its own TLB (useTLBs[i], for processor "i"), loaded
+//		by the kernel, rather than a page table.  If NULL and
+//		USE_TLB is defined, each gets a fully associative one of
+//		TLBSize entries.
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool threaded, int numCPUs, TLB **useTLBs)
 {
     int i;
 
+    ASSERT(numCPUs >= 1 && numCPUs <= MaxCPUs);
+    this->numCPUs = numCPUs;
+    cpu = 0;
+    processors = new Processor[numCPUs];
     for (i = 0; i < NumTotalRegs; i++)
         registers[i] = 0;
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
-#ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
-    pageTable = NULL;
-#else	// use linear page table
-    tlb = NULL;
+    decoded = new Instruction[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++) {
+	decoded[i].value = 0;		// matches the zeroed memory
+	decoded[i].Decode();
+    }
     pageTable = NULL;
+    pageTableSize = 0;
+    for (i = numCPUs - 1; i >= 0; i--) {	// ending with processor 0's
+	tlb = (useTLBs != NULL) ? useTLBs[i] : NULL;
+#ifdef USE_TLB
+	if (tlb == NULL)
+	    tlb = new TLB(TLBSize, TLBSize, LRUReplacement);
 #endif
+	bcopy(registers, processors[i].registers, sizeof(registers));
+	processors[i].tlb = tlb;
+	processors[i].pageTable = pageTable;
+	processors[i].pageTableSize = pageTableSize;
+    }
+
+    blocks = threaded ? new BlockCache : NULL;
+    blockPC = -1;
+    sliceLeft = CPUSlice;
+    quietTicks = 0;
+    FlushTranslations();
 
     singleStep = debug;
     CheckEndian();
@@ -83,8 +138,83 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
-    if (tlb != NULL)
-        delete [] tlb;
+    delete [] decoded;
+    delete blocks;
+    processors[cpu].tlb = tlb;
+    for (int i = 0; i < numCPUs; i++)
+	delete processors[i].tlb;
+    delete [] processors;
+}
+
+//----------------------------------------------------------------------
+// Machine::SwitchCPU
+// 	Put away the state of the running processor, and bring in that
+//	of processor "which", which runs from now on, starting its turn.
+//	The kernel has to switch to the thread it was running as well.
+//
+//	The state is copied rather than pointed to, so that the rest of
+//	the machine need not know there is more than one processor.
+//----------------------------------------------------------------------
+
+void
+Machine::SwitchCPU(int which)
+{
+    Processor *from = &processors[cpu], *to = &processors[which];
+
+    ASSERT(which >= 0 && which < numCPUs);
+    sliceLeft = CPUSlice;
+    if (which == cpu)
+	return;
+    bcopy(registers, from->registers, sizeof(registers));
+    bcopy(translations, from->translations, sizeof(translations));
+    from->tlb = tlb;
+    from->pageTable = pageTable;
+    from->pageTableSize = pageTableSize;
+
+    bcopy(to->registers, registers, sizeof(registers));
+    bcopy(to->translations, translations, sizeof(translations));
+    tlb = to->tlb;
+    pageTable = to->pageTable;
+    pageTableSize = to->pageTableSize;
+    cpu = which;
+}
+
+//----------------------------------------------------------------------
+// Machine::EndRound
+// 	Called by the scheduler once every processor with a thread has
+//	had its turn.  They all ran at once, so simulated time advances
+//	by one turn, as if the processor running now had just run it
+//	alone; interrupts that come due meanwhile happen, and so does a
+//	profile sample.
+//----------------------------------------------------------------------
+
+void
+Machine::EndRound()
+{
+    Profiler *profiler = kernel->profiler;
+
+    for (int i = 0; i < CPUSlice; i++)
+	kernel->interrupt->OneTick();
+    if (profiler != NULL && kernel->stats->totalTicks >= profiler->NextSample())
+	profiler->Sample();
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushSpace
+// 	Forget what the TLB of every processor holds of address space
+//	"asid": the space went away, or its tag is being reused, or its
+//	page table changed.  Nothing to do without TLBs.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushSpace(int asid)
+{
+    if (tlb == NULL)
+	return;
+    tlb->FlushSpace(asid);
+    for (int i = 0; i < numCPUs; i++)
+	if (i != cpu)
+	    processors[i].tlb->FlushSpace(asid);
 }
 
 //----------------------------------------------------------------------
@@ -102,10 +232,13 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
 {
     DEBUG(dbgMach, "Exception: " << exceptionNames[which]);
     registers[BadVAddrReg] = badVAddr;
+    if (blockPC != -1)			// count the block's instructions
+	EndBlock((registers[PCReg] - blockPC) / 4);	// up to this one
     DelayedLoad(0, 0);			// finish anything in progress
     kernel->interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
     kernel->interrupt->setStatus(UserMode);
+    quietTicks = 0;			// the interrupts due may have changed
 }
 
 //----------------------------------------------------------------------
@@ -25,20 +25,23 @@
 #include "utility.h"
 #include "translate.h"
 
-// Definitions related to the size, and format of user memory
+// Definitions related to the size, and format of user memory.  The page
+// size and the amount of physical memory can be chosen when Nachos
+// starts (-ps and -ms), by calling SetMemorySize before the Machine is
+// created; after that they must not change.
 
-const int PageSize = 128; 		// set the page size equal to
-					// the disk sector size, for simplicity
+#define DefaultPageSize		128	// the disk sector size, for simplicity
+#define DefaultNumPhysPages	128
 
-//
-// You are allowed to change this value.
-// Doing so will change the number of pages of physical memory
-// available on the simulated machine.
-//
-const int NumPhysPages = 128;
+extern int PageSize;			// bytes in a page
+extern int NumPhysPages;		// pages of physical memory
+extern int MemorySize;			// NumPhysPages * PageSize
 
-const int MemorySize = (NumPhysPages * PageSize);
-const int TLBSize = 4;			// if there is a TLB, make it small
+extern void SetMemorySize(int pageSize, int memorySize);
+					// Use pages of "pageSize" bytes, and
+					// "memorySize" bytes of memory
+const int TLBSize = 4;			// if there is a TLB, make it small;
+					// see tlbsim.h
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -88,13 +91,77 @@ enum ExceptionType { NoException,           // Everything ok!
 // The procedures in this class are defined in machine.cc, mipssim.cc, and
 // translate.cc.
 
-class Instruction;
 class Interrupt;
+class BlockCache;
+class TLB;
+class BlockOp;
+
+// The following class defines an instruction, represented in both
+// 	undecoded binary form
+//      decoded to identify
+//	    operation to do
+//	    registers to act on
+//	    any immediate operand value
+
+class Instruction {
+  public:
+    void Decode();	// decode the binary representation of the instruction
+
+    unsigned int value; // binary representation of the instruction
+
+    char opCode;     // Type of instruction.  This is NOT the same as the
+    		     // opcode field from the instruction: see defs in mips.h
+    char rs, rt, rd; // Three registers from instruction.
+    int extra;       // Immediate or target or shamt field or offset.
+                     // Immediates are sign-extended.
+};
+
+// An entry of the translation cache, which remembers recent successful
+// translations by ReadMem and WriteMem, as pointers into mainMemory,
+// so that the next reference to the same page needs no checks at all.
+// It is only a cache of the page table or TLB: the kernel has to flush
+// it (Machine::FlushTranslations) whenever it changes those.
+
+#define TranslationCacheSize	32	// direct-mapped, by virtual page #
+
+class CachedTranslation {
+  public:
+    unsigned int virtualPage;	// the page; NoPage if the entry is empty
+    char *frame;		// where the page is, in mainMemory
+    bool writable;		// can be written without going through
+				// Translate: it isn't read-only, and
+				// is already marked dirty
+};
+
+#define NoPage	((unsigned int) -1)
+
+// The machine can have more than one processor (-cpus).  Each has its
+// own registers, translation cache, and TLB, and runs its own thread;
+// they share main memory.  The simulator only runs one at a time: they
+// take turns of CPUSlice instructions, and once each has had its turn,
+// simulated time advances by as much (see Machine::RunCPUs).  The one
+// running keeps its state in the Machine itself; the others keep
+// theirs here, until their turn comes (Machine::SwitchCPU).
+
+#define CPUSlice	10	// instructions in a processor's turn
+
+class Processor {
+  public:
+    int registers[NumTotalRegs];
+    CachedTranslation translations[TranslationCacheSize];
+    TLB *tlb;
+    TranslationEntry *pageTable;
+    unsigned int pageTableSize;
+};
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
-				// for running user programs
+    Machine(bool debug, bool threaded, int numCPUs, TLB **useTLBs);
+				// Initialize the simulation of the hardware
+				// for running user programs; "threaded"
+				// runs them as threaded code (blocksim.cc);
+				// "useTLBs", if not NULL, are the TLBs
+				// each processor translates through
     ~Machine();			// De-allocate the data structures
 
 // Routines callable by the Nachos kernel
@@ -105,6 +172,14 @@ class Machine {
     void WriteRegister(int num, int value);
 				// store a value into a CPU register
 
+    int numCPUs;		// processors the machine has, and the one
+    int cpu;			// running now; both "read-only" to the
+				// kernel
+    void SwitchCPU(int which);	// Run processor "which" from now on; its
+				// turn starts
+    void EndRound();		// Every processor with a thread has had
+				// its turn: advance simulated time
+
 // Data structures accessible to the Nachos kernel -- main memory and the
 // page table/TLB.
 //
@@ -132,7 +207,7 @@ class Machine {
 // Thus the TLB pointer should be considered as *read-only*, although 
 // the contents of the TLB are free to be modified by the kernel software.
 
-    TranslationEntry *tlb;		// this pointer should be considered 
+    TLB *tlb;				// this pointer should be considered 
 					// "read-only" to Nachos kernel code
 
     TranslationEntry *pageTable;
@@ -143,14 +218,38 @@ class Machine {
     				// Read or write 1, 2, or 4 bytes of virtual 
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
+    bool ReadWord(int addr, int *value);
+    bool WriteWord(int addr, int value);
+				// The same for 4 bytes, but quicker
+				// (inline; see below)
+    void FlushTranslations();	// Forget the cached translations, of
+				// every processor; called whenever the
+				// page table or TLB in use changes, or
+				// one of its entries does
+    void FlushSpace(int asid);	// Forget the entries of address space
+				// "asid" in every processor's TLB, if
+				// there are TLBs
   private:
 
 // Routines internal to the machine simulation -- DO NOT call these directly
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
 
-    void OneInstruction(Instruction *instr); 	
-    				// Run one instruction of a user program.
+    void OneInstruction(); 	// Run one instruction of a user program.
+    bool Execute(Instruction *instr);
+				// Run a decoded instruction; FALSE if
+				// it raised an exception
+
+    void RunBlocks();		// Run a user program as threaded code
+    void RunCPUs();		// Run it on one of several processors
+    void EndBlock(int done);	// Account for the time of the block
+				// being run
+    int NextStop();		// The tick at which Run next has to look
+				// around, or -1; see Machine::Run
+
+    bool FetchAddress(int virtAddr, int *physAddr);
+				// Translate the PC, quickly if its page
+				// is in the translation cache
     
 
 
@@ -173,12 +272,34 @@ class Machine {
 
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
 
+    CachedTranslation translations[TranslationCacheSize];
+				// recent translations; see ReadMem
+
+    Instruction *decoded;	// decoded[i] is the last decoding of the
+				// word at mainMemory[4 * i]; see
+				// OneInstruction
+    BlockCache *blocks;		// translated blocks, if we run user
+				// programs as threaded code; else NULL
+    int blockPC;		// where the block being run started;
+				// -1 if none is
+    Processor *processors;	// processors[i] is the state of processor
+				// "i", while it isn't running
+    int sliceLeft;		// instructions left in the running
+				// processor's turn
+
+    int quietTicks;		// instructions Run can still execute before
+				// an interrupt could be due; zeroed by
+				// RaiseException, since the kernel may
+				// have scheduled one, or switched threads
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
 				// time reaches this value
 
     friend class Interrupt;		// calls DelayedLoad()    
+    friend bool GenericOp(Machine *machine, int *registers, BlockOp *op);
+					// calls Execute()
 };
 
 extern void ExceptionHandler(ExceptionType which);
@@ -197,10 +318,86 @@ extern void ExceptionHandler(ExceptionType which);
 //	   user registers
 //	simulated machine byte ordering:
 //	   contents of main memory
-
-unsigned int WordToHost(unsigned int word);
-unsigned short ShortToHost(unsigned short shortword);
-unsigned int WordToMachine(unsigned int word);
-unsigned short ShortToMachine(unsigned short shortword);
+//
+// They are used on every memory reference, so they are inline, and on a
+// little endian host the compiler drops them altogether.  Which kind of
+// host we are on is settled when Nachos is compiled: Makefile.dep
+// defines HOST_IS_BIG_ENDIAN on big endian hosts, and if it doesn't, we
+// go by what the compiler says.  (CheckEndian makes sure at startup.)
+
+#if !defined(HOST_IS_BIG_ENDIAN) && defined(__BYTE_ORDER__) && \
+	defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_IS_BIG_ENDIAN
+#endif
+
+inline unsigned int
+WordToHost(unsigned int word) {
+#ifdef HOST_IS_BIG_ENDIAN
+	 register unsigned long result;
+	 result = (word >> 24) & 0x000000ff;
+	 result |= (word >> 8) & 0x0000ff00;
+	 result |= (word << 8) & 0x00ff0000;
+	 result |= (word << 24) & 0xff000000;
+	 return result;
+#else 
+	 return word;
+#endif /* HOST_IS_BIG_ENDIAN */
+}
+
+inline unsigned short
+ShortToHost(unsigned short shortword) {
+#ifdef HOST_IS_BIG_ENDIAN
+	 register unsigned short result;
+	 result = (shortword << 8) & 0xff00;
+	 result |= (shortword >> 8) & 0x00ff;
+	 return result;
+#else 
+	 return shortword;
+#endif /* HOST_IS_BIG_ENDIAN */
+}
+
+inline unsigned int
+WordToMachine(unsigned int word) { return WordToHost(word); }
+
+inline unsigned short
+ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
+
+//----------------------------------------------------------------------
+// Machine::ReadWord, Machine::WriteWord
+//	ReadMem and WriteMem of a word, for the loads and stores and
+//	instruction fetches that make up most memory references.  When
+//	the address is aligned and its page is in the translation cache,
+//	this is a single host load or store (with no byte swapping, on a
+//	little endian host); anything else goes through ReadMem or
+//	WriteMem, which raise the exception if there is one.
+//----------------------------------------------------------------------
+
+inline bool
+Machine::ReadWord(int addr, int *value)
+{
+    unsigned int vpn = (unsigned) addr / PageSize;
+    CachedTranslation *cached = &translations[vpn % TranslationCacheSize];
+
+    if (cached->virtualPage == vpn && !(addr & 0x3)) {
+	*value = WordToHost(*(unsigned int *) 
+			(cached->frame + (unsigned) addr % PageSize));
+	return TRUE;
+    }
+    return ReadMem(addr, 4, value);
+}
+
+inline bool
+Machine::WriteWord(int addr, int value)
+{
+    unsigned int vpn = (unsigned) addr / PageSize;
+    CachedTranslation *cached = &translations[vpn % TranslationCacheSize];
+
+    if (cached->virtualPage == vpn && cached->writable && !(addr & 0x3)) {
+	*(unsigned int *) (cached->frame + (unsigned) addr % PageSize) = 
+			WordToMachine((unsigned int) value);
+	return TRUE;
+    }
+    return WriteMem(addr, 4, value);
+}
 
 #endif // MACHINE_H
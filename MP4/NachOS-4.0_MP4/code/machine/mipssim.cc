@@ -21,28 +21,13 @@
 #include "machine.h"
 #include "mipssim.h"
 #include "main.h"
+#include "profile.h"
+#include "checkpoint.h"
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
-// The following class defines an instruction, represented in both
-// 	undecoded binary form
-//      decoded to identify
-//	    operation to do
-//	    registers to act on
-//	    any immediate operand value
-
-class Instruction {
-  public:
-    void Decode();	// decode the binary representation of the instruction
-
-    unsigned int value; // binary representation of the instruction
-
-    char opCode;     // Type of instruction.  This is NOT the same as the
-    		     // opcode field from the instruction: see defs in mips.h
-    char rs, rt, rd; // Three registers from instruction.
-    int extra;       // Immediate or target or shamt field or offset.
-                     // Immediates are sign-extended.
-};
+#define QuietCheck	1000	// with nothing pending, how many instructions
+				// Run lets go by between calls to OneTick
 
 //----------------------------------------------------------------------
 // Machine::Run
@@ -51,26 +36,134 @@ class Instruction {
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	If the machine runs threaded code, RunBlocks does the work, unless
+//	we are single-stepping or tracing every instruction, or have a TLB
+//	(whose every lookup should be counted).
+//
+//	Otherwise, after each instruction simulated time has to advance by
+//	a tick.  Interrupt::OneTick does that, but also turns interrupts
+//	off and on and looks for interrupts that are due; until the next
+//	pending one is, all it would do is the first part, so we do just
+//	that ourselves.  "quietTicks" counts the instructions left before
+//	then; when an exception is raised the kernel runs, and may change
+//	what is pending, so RaiseException sets it back to zero, and the
+//	next tick goes through OneTick.
+//
+//	When the user program is being profiled, a sample is due every so
+//	often too; the tick that reaches it also goes through OneTick, and
+//	then we take it.  So do checkpoints of the machine.
+//
+//	A machine with more than one processor runs user programs with
+//	RunCPUs instead.
 //----------------------------------------------------------------------
 
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;  // storage for decoded instruction
-
     if (debug->IsEnabled('m')) {
         cout << "Starting program in thread: " << kernel->currentThread->getName();
 		cout << ", at time: " << kernel->stats->totalTicks << "\n";
     }
     kernel->interrupt->setStatus(UserMode);
+    if (numCPUs > 1)
+	RunCPUs();
+    if (blocks != NULL && tlb == NULL && !singleStep && 
+		!debug->IsEnabled('m'))
+	RunBlocks();
+    if (singleStep || debug->IsEnabled(dbgInt)) {
+	for (;;) {			// one tick at a time
+	    OneInstruction();
+	    kernel->interrupt->OneTick();
+	    if (kernel->profiler != NULL && 
+		    kernel->stats->totalTicks >= kernel->profiler->NextSample())
+		kernel->profiler->Sample();
+	    if (kernel->checkpoint != NULL && kernel->stats->totalTicks >= 
+			kernel->checkpoint->NextCheckpoint())
+		kernel->checkpoint->Take();
+	    if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
+		Debugger();
+	}
+    }
+    quietTicks = 0;
     for (;;) {
-        OneInstruction(instr);
-		kernel->interrupt->OneTick();
-		if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
-	  		Debugger();
+	OneInstruction();
+	if (quietTicks > 0) {		// nothing can be due yet
+	    quietTicks--;
+	    kernel->stats->totalTicks += UserTick;
+	    kernel->stats->userTicks += UserTick;
+	} else {
+	    kernel->interrupt->OneTick();
+	    int due = NextStop();
+	    int now = kernel->stats->totalTicks;
+	    if (due == -1)		// nothing pending: look again now
+		quietTicks = QuietCheck;	// and then
+	    else if (due > now)		// ticks that end before "due"
+		quietTicks = (due - now - 1) / UserTick;
+	}
     }
 }
 
+//----------------------------------------------------------------------
+// Machine::RunCPUs
+// 	Run a user program on a machine with more than one processor,
+//	interpreting it; never returns.
+//
+//	The processors take turns: at the end of each turn, the scheduler
+//	switches to the next processor that has a thread to run (and to
+//	that thread), or gives an idle one a ready thread.  Instructions
+//	don't advance simulated time themselves; once each processor has
+//	had its turn, the scheduler calls EndRound, which does.  The
+//	kernel only ever runs on one processor at a time, as though it
+//	were protected by a single lock: while it does, simulated time
+//	advances for all of them, and the others are idle.
+//----------------------------------------------------------------------
+
+void
+Machine::RunCPUs()
+{
+    for (;;) {
+	OneInstruction();
+	kernel->stats->cpuUserTicks[cpu] += UserTick;
+	if (--sliceLeft > 0)
+	    continue;
+	sliceLeft = CPUSlice;
+	kernel->scheduler->NextCPU();	// returns on our next turn
+	if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
+	    Debugger();
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::NextStop
+// 	Return the tick at which Run has to go through OneTick again: when
+//	the next interrupt is due, or the next profile sample or checkpoint,
+//	whichever comes first; -1 if none is pending.  A sample or a
+//	checkpoint already due is taken first.
+//----------------------------------------------------------------------
+
+int
+Machine::NextStop()
+{
+    Profiler *profiler = kernel->profiler;
+    Checkpoint *checkpoint = kernel->checkpoint;
+    int due = kernel->interrupt->NextDue();
+
+    if (profiler != NULL) {
+	if (kernel->stats->totalTicks >= profiler->NextSample())
+	    profiler->Sample();
+	if (due == -1 || profiler->NextSample() < due)
+	    due = profiler->NextSample();
+    }
+    if (checkpoint != NULL) {
+	if (kernel->stats->totalTicks >= checkpoint->NextCheckpoint())
+	    checkpoint->Take();
+	if (due == -1 || checkpoint->NextCheckpoint() < due)
+	    due = checkpoint->NextCheckpoint();
+    }
+    return due;
+}
+
 
 //----------------------------------------------------------------------
 // TypeToReg
@@ -115,25 +208,29 @@ TypeToReg(RegType reg, Instruction *instr)
 //	leaving.  This allows the Nachos kernel to control our behavior
 //	by controlling the contents of memory, the translation table,
 //	and the register set.
+//
+//	The one exception is the decoding of each word of physical memory,
+//	which is kept in "decoded" so that a loop is only decoded once.
+//	Each decoding remembers the word it came from, and is only used
+//	if memory still holds that word; so whoever changes memory --
+//	a store, the loader, paging, a mapped file -- never has to say so.
 //----------------------------------------------------------------------
 
 void
-Machine::OneInstruction(Instruction *instr)
+Machine::OneInstruction()
 {
-#ifdef SIM_FIX
-    int byte;       // described in Kane for LWL,LWR,...
-#endif
-
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-				// in the future
+    Instruction *instr;
+    int raw, physAddr;
 
     // Fetch instruction 
-    if (!ReadMem(registers[PCReg], 4, &raw))
+    if (!FetchAddress(registers[PCReg], &physAddr))
 	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
+    raw = WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+    instr = &decoded[physAddr / 4];
+    if (instr->value != (unsigned int) raw) {	// new, or overwritten
+	instr->value = raw;
+	instr->Decode();
+    }
 
     if (debug->IsEnabled('m')) {
         struct OpString *str = &opStrings[instr->opCode];
@@ -145,7 +242,28 @@ Machine::OneInstruction(Instruction *instr)
 	     TypeToReg(str->args[1], instr), TypeToReg(str->args[2], instr));
         cout << "\t" << buf << "\n";
     }
-    
+    (void) Execute(instr);
+}
+
+//----------------------------------------------------------------------
+// Machine::Execute
+// 	Execute the decoded instruction "instr", at the PC, and advance
+//	the PC past it.  Returns FALSE if it raised an exception instead;
+//	the PC then still points at it (except after a system call, whose
+//	handler moves the PC on).
+//----------------------------------------------------------------------
+
+bool
+Machine::Execute(Instruction *instr)
+{
+#ifdef SIM_FIX
+    int byte;       // described in Kane for LWL,LWR,...
+#endif
+
+    int nextLoadReg = 0; 	
+    int nextLoadValue = 0; 	// record delayed load operation, to apply
+				// in the future
+
     // Compute next pc, but don't install in case there's an error or branch.
     int pcAfter = registers[NextPCReg] + 4;
     int sum, diff, tmp, value;
@@ -159,7 +277,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -169,7 +287,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -264,7 +382,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
 	if (!ReadMem(tmp, 1, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -279,10 +397,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!ReadMem(tmp, 2, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -301,10 +419,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
-	if (!ReadMem(tmp, 4, &value))
-	    return;
+	if (!ReadWord(tmp, &value))
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
@@ -324,7 +442,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 #else
 	// ReadMem assumes all 4 byte requests are aligned on an even 
 	// word boundary.  Also, the little endian/big endian swap code would
@@ -332,7 +450,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 	if (registers[LoadReg] == instr->rt)
@@ -376,7 +494,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 #else
 	// ReadMem assumes all 4 byte requests are aligned on an even 
 	// word boundary.  Also, the little endian/big endian swap code would
@@ -384,7 +502,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 	if (registers[LoadReg] == instr->rt)
@@ -458,13 +576,13 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SB:
 	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SH:
 	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SLL:
@@ -534,7 +652,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -544,9 +662,9 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_SW:
-	if (!WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	if (!WriteWord((unsigned) 
+		(registers[instr->rs] + instr->extra), registers[instr->rt]))
+	    return FALSE;
 	break;
 	
       case OP_SWL:	  
@@ -562,7 +680,7 @@ Machine::OneInstruction(Instruction *instr)
         byte = tmp & 0x3;
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 
         // DEBUG('P', "Value 0x%X\n",value);
 #else
@@ -572,7 +690,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 #ifdef SIM_FIX
@@ -599,12 +717,12 @@ Machine::OneInstruction(Instruction *instr)
 	}
 #ifndef SIM_FIX
         if (!WriteMem((tmp & ~0x3), 4, value))
-            return;
+            return FALSE;
 #else
         // DEBUG('P', "Value 0x%X\n",value);
 
         if (!WriteMem((tmp - byte), 4, value))
-            return;
+            return FALSE;
 #endif // SIM_FIX
 	break;
     	
@@ -617,7 +735,7 @@ Machine::OneInstruction(Instruction *instr)
         ASSERT((tmp & 0x3) == 0);  
 
         if (!ReadMem((tmp & ~0x3), 4, &value))
-            return;
+            return FALSE;
 #else
         // The only difference between this code and the BIG ENDIAN code
         // is that the ReadMem call is guaranteed an aligned access as 
@@ -630,7 +748,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
         // DEBUG('P', "Value 0x%X\n",value);
 #endif // SIM_FIX
 
@@ -656,12 +774,12 @@ Machine::OneInstruction(Instruction *instr)
 
 #ifndef SIM_FIX
         if (!WriteMem((tmp & ~0x3), 4, value))
-            return;
+            return FALSE;
 #else
         // DEBUG('P', "Value 0x%X\n",value);
 
         if (!WriteMem((tmp - byte), 4, value))
-            return;
+            return FALSE;
 #endif // SIM_FIX
 
 
@@ -669,7 +787,7 @@ Machine::OneInstruction(Instruction *instr)
     	
       case OP_SYSCALL:
 	RaiseException(SyscallException, 0);
-	return; 
+	return FALSE; 
 	
       case OP_XOR:
 	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -682,7 +800,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
 	ASSERT(FALSE);
@@ -698,6 +816,7 @@ Machine::OneInstruction(Instruction *instr)
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
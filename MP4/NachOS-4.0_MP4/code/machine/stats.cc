@@ -22,6 +22,9 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numTLBHits = numTLBMisses = 0;
+    for (int i = 0; i < MaxCPUs; i++)
+	cpuUserTicks[i] = cpuSystemTicks[i] = cpuDispatches[i] = 0;
 }
 
 //----------------------------------------------------------------------
@@ -40,6 +43,41 @@ Statistics::Print()
 		cout << "Console I/O: reads " << numConsoleCharsRead;
     cout << ", writes " << numConsoleCharsWritten << "\n";
     cout << "Paging: faults " << numPageFaults << "\n";
+    if (numTLBHits + numTLBMisses > 0)
+	PrintTLB();
     cout << "Network I/O: packets received " << numPacketsRecvd;
 		cout << ", sent " << numPacketsSent << "\n";
 }
+
+//----------------------------------------------------------------------
+// Statistics::PrintTLB
+// 	Print how often translations were found in the TLB.
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintTLB()
+{
+    int lookups = numTLBHits + numTLBMisses;
+
+    cout << "TLB: hits " << numTLBHits << ", misses " << numTLBMisses;
+    cout << ", hit ratio " << (lookups > 0 ? 
+		(double) numTLBHits / lookups : 0.0) << "\n";
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintCPUs
+// 	Print how each of "numCPUs" processors spent its time.  A
+//	processor was idle whenever it wasn't running anything: with no
+//	thread, or while another one was in the kernel.
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintCPUs(int numCPUs)
+{
+    for (int i = 0; i < numCPUs; i++) {
+	cout << "CPU " << i << ": user " << cpuUserTicks[i];
+	cout << ", system " << cpuSystemTicks[i] << ", idle " 
+		<< totalTicks - cpuUserTicks[i] - cpuSystemTicks[i];
+	cout << ", threads dispatched " << cpuDispatches[i] << "\n";
+    }
+}
@@ -13,6 +13,8 @@
 
 #include "copyright.h"
 
+#define MaxCPUs		8	// processors the machine can have (-cpus)
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -33,12 +35,22 @@ class Statistics {
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numTLBHits;		// number of translations found in the TLB
+    int numTLBMisses;		// and not found there
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
 
+    int cpuUserTicks[MaxCPUs];	// with more than one processor, the
+    int cpuSystemTicks[MaxCPUs];// user instructions each ran, the time
+    int cpuDispatches[MaxCPUs];	// each spent in the kernel, and the
+				// threads each was given; see
+				// Machine::RunCPUs
+
     Statistics(); 		// initialize everything to zero
 
     void Print();		// print collected statistics
+    void PrintTLB();		// just the TLB's
+    void PrintCPUs(int numCPUs);// just the processors'
 };
 
 // Constants used to reflect the relative time an operation would
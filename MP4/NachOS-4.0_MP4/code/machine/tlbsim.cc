@@ -0,0 +1,148 @@
+// tlbsim.cc -- a set-associative, software-loaded TLB
+//
+//   See tlbsim.h for how it is organized.  Lookups are made by
+//   Machine::Translate on every memory reference; a miss raises a
+//   PageFaultException, and the kernel (AddrSpace::LoadTLB) loads the
+//   missing translation from the page table.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#include "tlbsim.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// TLB::TLB
+// 	Initialize an empty TLB of "size" entries, "ways" to a set,
+//	replaced according to "policy".
+//----------------------------------------------------------------------
+
+TLB::TLB(int tlbSize, int tlbWays, ReplacementPolicy replace)
+{
+    ASSERT(tlbWays >= 2 && tlbSize % tlbWays == 0);
+    size = tlbSize;
+    ways = tlbWays;
+    numSets = size / ways;
+    policy = replace;
+    entries = new TranslationEntry[size];
+    asids = new int[size];
+    stamps = new int[size];
+    for (int i = 0; i < size; i++) {
+	entries[i].valid = FALSE;
+	asids[i] = -1;
+	stamps[i] = 0;
+    }
+    space = 0;
+    clock = 0;
+}
+
+//----------------------------------------------------------------------
+// TLB::~TLB
+// 	De-allocate the TLB.
+//----------------------------------------------------------------------
+
+TLB::~TLB()
+{
+    delete [] entries;
+    delete [] asids;
+    delete [] stamps;
+}
+
+//----------------------------------------------------------------------
+// TLB::Lookup
+// 	Return the entry translating virtual page "vpn" of the running
+//	address space, or NULL if there is none.  Only the set "vpn"
+//	maps to has to be searched.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+TLB::Lookup(int vpn)
+{
+    int first = (vpn % numSets) * ways;
+
+    for (int i = first; i < first + ways; i++)
+	if (entries[i].valid && entries[i].virtualPage == vpn &&
+		asids[i] == space) {
+	    if (policy == LRUReplacement)
+		stamps[i] = ++clock;
+	    kernel->stats->numTLBHits++;
+	    return &entries[i];
+	}
+    kernel->stats->numTLBMisses++;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// TLB::Load
+// 	Load a copy of "pte", the page table entry of one page of the
+//	running address space.  An entry the page already has (say,
+//	before it was dirty) is overwritten; otherwise one is chosen by
+//	Victim.
+//----------------------------------------------------------------------
+
+void
+TLB::Load(TranslationEntry *pte)
+{
+    int set = pte->virtualPage % numSets;
+    TranslationEntry *entry = NULL;
+
+    for (int i = set * ways; i < (set + 1) * ways; i++)
+	if (entries[i].valid && entries[i].virtualPage == pte->virtualPage &&
+		asids[i] == space) {
+	    entry = &entries[i];
+	    break;
+	}
+    if (entry == NULL)
+	entry = Victim(set);
+
+    *entry = *pte;
+    entry->valid = TRUE;
+    asids[entry - entries] = space;
+    stamps[entry - entries] = ++clock;
+    DEBUG(dbgAddr, "TLB load of page " << pte->virtualPage << " in space "
+		<< space << (pte->dirty ? ", writable" : ""));
+}
+
+//----------------------------------------------------------------------
+// TLB::Victim
+// 	Choose the entry of set "set" to load a new translation into: an
+//	empty one if there is one, else the one the policy picks.
+//----------------------------------------------------------------------
+
+TranslationEntry *
+TLB::Victim(int set)
+{
+    int first = set * ways;
+    int victim = first;
+
+    for (int i = first; i < first + ways; i++)
+	if (!entries[i].valid)
+	    return &entries[i];
+
+    if (policy == RandomReplacement)
+	victim = first + RandomNumber() % ways;
+    else {			// LRU and FIFO: the oldest stamp
+	for (int i = first + 1; i < first + ways; i++)
+	    if (stamps[i] < stamps[victim])
+		victim = i;
+    }
+    return &entries[victim];
+}
+
+//----------------------------------------------------------------------
+// TLB::FlushSpace
+// 	Invalidate every entry belonging to address space "asid".
+//----------------------------------------------------------------------
+
+void
+TLB::FlushSpace(int asid)
+{
+    for (int i = 0; i < size; i++)
+	if (asids[i] == asid)
+	    entries[i].valid = FALSE;
+}
@@ -0,0 +1,89 @@
+// tlbsim.h
+//	Data structures for simulating a software-loaded, set-associative
+//	translation lookaside buffer.
+//
+//	The TLB has "size" entries, in sets of "ways" each: virtual page
+//	"vpn" can only be held by set (vpn % number of sets), and "ways" ==
+//	"size" is fully associative.  When the kernel loads a translation
+//	into a full set, an entry is replaced by least recent use, by age
+//	(first in, first out), or at random.
+//
+//	There must be at least two ways, since an instruction needs two
+//	translations at once: its own page's and the one of the data it
+//	loads or stores.  With one, if both pages fell in the same set,
+//	loading either would push the other out, forever.
+//
+//	Each entry is tagged with the address space it belongs to (its
+//	ASID), and only matches while that space is running, so a context
+//	switch need not flush the TLB.
+//
+//	As on the MIPS, a TLB entry only allows writes once its dirty bit
+//	is set.  The first write to a page that is clean in the TLB traps
+//	to the kernel (as a ReadOnlyException), which marks the page dirty
+//	in its page table, and loads the translation again.  That way the
+//	page table always knows which pages are dirty, and nothing has to
+//	be copied back when an entry is replaced.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TLBSIM_H
+#define TLBSIM_H
+
+#include "copyright.h"
+#include "translate.h"
+
+#define NumASIDs	64	// address space tags, as on the MIPS
+
+// How to choose which entry of a full set to replace.
+
+enum ReplacementPolicy { LRUReplacement,	// least recently used
+			 FIFOReplacement,	// loaded longest ago
+			 RandomReplacement	// any
+};
+
+// The following class defines the TLB.  Machine::Translate looks
+// pages up in it; the kernel loads it on misses, and tells it which
+// address space is running.
+
+class TLB {
+  public:
+    TLB(int size, int ways, ReplacementPolicy policy);
+				// An empty TLB; "size" must be a
+				// multiple of "ways"
+    ~TLB();
+
+    TranslationEntry *Lookup(int vpn);
+				// The entry for "vpn" in the running
+				// space, or NULL on a miss; counted in
+				// kernel->stats
+    void Load(TranslationEntry *pte);
+				// Load a copy of the page table entry
+				// "pte" of the running space, replacing
+				// any entry for the same page
+
+    void SetSpace(int asid) { space = asid; }
+				// Address space "asid" is now running
+    void FlushSpace(int asid);	// Forget the entries of "asid", when the
+				// space goes away or its tag is reused, or
+				// its page table changes
+
+  private:
+    TranslationEntry *Victim(int set);
+				// The entry of "set" to load into
+
+    TranslationEntry *entries;	// size entries; set s is entries
+				// [s * ways, (s + 1) * ways)
+    int *asids;			// asids[i] tags entries[i]
+    int *stamps;		// time entries[i] was last used (LRU),
+				// or loaded (FIFO)
+    int size, ways, numSets;
+    ReplacementPolicy policy;
+    int space;			// ASID of the running space
+    int clock;			// counts lookups and loads, for stamps
+};
+
+#endif // TLBSIM_H
@@ -12,7 +12,8 @@
 //	Translation lookaside buffer -- associative lookup in the table
 //	to find an entry with the same virtual page #.  If found,
 //	this entry is used for the translation.
-//	If not, it traps to software with an exception. 
+//	If not, it traps to software with an exception.  (See tlbsim.h
+//	for the TLB itself.)
 //
 //	In practice, the TLB is much smaller than the amount of physical
 //	memory (16 entries is common on a machine that has 1000's of
@@ -31,49 +32,63 @@
 
 #include "copyright.h"
 #include "main.h"
+#include "tlbsim.h"
 
-// Routines for converting Words and Short Words to and from the
-// simulated machine's format of little endian.  These end up
-// being NOPs when the host machine is also little endian (DEC and Intel).
-
-unsigned int
-WordToHost(unsigned int word) {
-#ifdef HOST_IS_BIG_ENDIAN
-	 register unsigned long result;
-	 result = (word >> 24) & 0x000000ff;
-	 result |= (word >> 8) & 0x0000ff00;
-	 result |= (word << 8) & 0x00ff0000;
-	 result |= (word << 24) & 0xff000000;
-	 return result;
-#else 
-	 return word;
-#endif /* HOST_IS_BIG_ENDIAN */
-}
+//----------------------------------------------------------------------
+// LoadFrom, StoreTo
+//	Read or write "size" (1, 2, or 4) bytes of simulated memory, at
+//	"where" in mainMemory, converting to and from the simulated
+//	machine's byte order.
+//----------------------------------------------------------------------
 
-unsigned short
-ShortToHost(unsigned short shortword) {
-#ifdef HOST_IS_BIG_ENDIAN
-	 register unsigned short result;
-	 result = (shortword << 8) & 0xff00;
-	 result |= (shortword >> 8) & 0x00ff;
-	 return result;
-#else 
-	 return shortword;
-#endif /* HOST_IS_BIG_ENDIAN */
-}
+static int
+LoadFrom(char *where, int size)
+{
+    switch (size) {
+      case 1:
+	return *where;
+	
+      case 2:
+	return ShortToHost(*(unsigned short *) where);
+	
+      case 4:
+	return WordToHost(*(unsigned int *) where);
 
-unsigned int
-WordToMachine(unsigned int word) { return WordToHost(word); }
+      default: ASSERT(FALSE);
+    }
+    return 0;
+}
 
-unsigned short
-ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
+static void
+StoreTo(char *where, int size, int value)
+{
+    switch (size) {
+      case 1:
+	*where = (unsigned char) (value & 0xff);
+	break;
 
+      case 2:
+	*(unsigned short *) where
+		= ShortToMachine((unsigned short) (value & 0xffff));
+	break;
+      
+      case 4:
+	*(unsigned int *) where = WordToMachine((unsigned int) value);
+	break;
+	
+      default: ASSERT(FALSE);
+    }
+}
 
 //----------------------------------------------------------------------
 // Machine::ReadMem
 //      Read "size" (1, 2, or 4) bytes of virtual memory at "addr" into 
 //	the location pointed to by "value".
 //
+//	If the page was translated recently, the translation cache has
+//	where it is; otherwise Translate does the work (and fills in the
+//	cache).
+//
 //   	Returns FALSE if the translation step from virtual to physical memory
 //   	failed.
 //
@@ -85,10 +100,16 @@ ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 bool
 Machine::ReadMem(int addr, int size, int *value)
 {
-    int data;
     ExceptionType exception;
     int physicalAddress;
+    unsigned int vpn = (unsigned) addr / PageSize;
+    CachedTranslation *cached = &translations[vpn % TranslationCacheSize];
     
+    if (cached->virtualPage == vpn && !(addr & (size - 1))) {
+	*value = LoadFrom(cached->frame + (unsigned) addr % PageSize, size);
+	return TRUE;
+    }
+
     DEBUG(dbgAddr, "Reading VA " << addr << ", size " << size);
     
     exception = Translate(addr, &physicalAddress, size, FALSE);
@@ -96,24 +117,7 @@ Machine::ReadMem(int addr, int size, int *value)
 	RaiseException(exception, addr);
 	return FALSE;
     }
-    switch (size) {
-      case 1:
-	data = mainMemory[physicalAddress];
-	*value = data;
-	break;
-	
-      case 2:
-	data = *(unsigned short *) &mainMemory[physicalAddress];
-	*value = ShortToHost(data);
-	break;
-	
-      case 4:
-	data = *(unsigned int *) &mainMemory[physicalAddress];
-	*value = WordToHost(data);
-	break;
-
-      default: ASSERT(FALSE);
-    }
+    *value = LoadFrom(&mainMemory[physicalAddress], size);
     
     DEBUG(dbgAddr, "\tvalue read = " << *value);
     return (TRUE);
@@ -124,6 +128,10 @@ Machine::ReadMem(int addr, int size, int *value)
 //      Write "size" (1, 2, or 4) bytes of the contents of "value" into
 //	virtual memory at location "addr".
 //
+//	As in ReadMem, a cached translation is used if there is one, but
+//	only if it allows writing; otherwise Translate has to check the
+//	page, and mark it dirty.
+//
 //   	Returns FALSE if the translation step from virtual to physical memory
 //   	failed.
 //
@@ -137,7 +145,15 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    unsigned int vpn = (unsigned) addr / PageSize;
+    CachedTranslation *cached = &translations[vpn % TranslationCacheSize];
      
+    if (cached->virtualPage == vpn && cached->writable && 
+		!(addr & (size - 1))) {
+	StoreTo(cached->frame + (unsigned) addr % PageSize, size, value);
+	return TRUE;
+    }
+
     DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
 
     exception = Translate(addr, &physicalAddress, size, TRUE);
@@ -145,24 +161,64 @@ Machine::WriteMem(int addr, int size, int value)
 	RaiseException(exception, addr);
 	return FALSE;
     }
-    switch (size) {
-      case 1:
-	mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
-	break;
+    StoreTo(&mainMemory[physicalAddress], size, value);
+    
+    return TRUE;
+}
 
-      case 2:
-	*(unsigned short *) &mainMemory[physicalAddress]
-		= ShortToMachine((unsigned short) (value & 0xffff));
-	break;
-      
-      case 4:
-	*(unsigned int *) &mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
-	break;
-	
-      default: ASSERT(FALSE);
+//----------------------------------------------------------------------
+// Machine::FlushTranslations
+//      Empty the translation cache.  It holds copies of page table or
+//	TLB entries (with their use bits, and dirty bits if writable,
+//	already set), so the kernel must call this whenever it switches
+//	to another page table, or changes an entry of the one in use --
+//	makes a page valid or invalid, moves it, or clears its use or
+//	dirty bit.
+//
+//	With more than one processor, the caches of those not running
+//	are emptied too, since we don't know which have copies.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTranslations()
+{
+    for (int i = 0; i < TranslationCacheSize; i++)
+	translations[i].virtualPage = NoPage;
+    for (int c = 0; c < numCPUs; c++)
+	if (c != cpu)
+	    for (int i = 0; i < TranslationCacheSize; i++)
+		processors[c].translations[i].virtualPage = NoPage;
+}
+
+//----------------------------------------------------------------------
+// Machine::FetchAddress
+//      Translate "virtAddr", the address of the next instruction, into
+//	"physAddr".  Instruction fetch is the one memory reference every
+//	instruction makes, so the usual case -- an aligned address in a
+//	page in the translation cache -- is handled right here; anything
+//	else goes through Translate.
+//
+//   	Returns FALSE if the translation failed; the exception has then
+//	been raised.
+//----------------------------------------------------------------------
+
+bool
+Machine::FetchAddress(int virtAddr, int *physAddr)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    CachedTranslation *cached = &translations[vpn % TranslationCacheSize];
+    ExceptionType exception;
+
+    if (cached->virtualPage == vpn && !(virtAddr & 0x3)) {
+	*physAddr = (cached->frame - mainMemory) + 
+			(unsigned) virtAddr % PageSize;
+	return TRUE;
+    }
+    exception = Translate(virtAddr, physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, virtAddr);
+	return FALSE;
     }
-    
     return TRUE;
 }
 
@@ -178,13 +234,13 @@ Machine::WriteMem(int addr, int size, int value)
 //	"virtAddr" -- the virtual address to translate
 //	"physAddr" -- the place to store the physical address
 //	"size" -- the amount of memory being read or written
-// 	"writing" -- if TRUE, check the "read-only" bit in the TLB
+// 	"writing" -- if TRUE, check the "read-only" bit in the TLB, and
+//		with a TLB, that the page is already dirty
 //----------------------------------------------------------------------
 
 ExceptionType
 Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 {
-    int i;
     unsigned int vpn, offset;
     TranslationEntry *entry;
     unsigned int pageFrame;
@@ -215,17 +271,18 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	}
 	entry = &pageTable[vpn];
     } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    if (tlb[i].valid && (tlb[i].virtualPage == ((int)vpn))) {
-		entry = &tlb[i];			// FOUND!
-		break;
-	    }
+	entry = tlb->Lookup(vpn);
 	if (entry == NULL) {				// not found
     	    DEBUG(dbgAddr, "Invalid TLB entry for this virtual page!");
     	    return PageFaultException;		// really, this is a TLB fault,
 						// the page may be in memory,
 						// but not in the TLB
 	}
+	if (writing && !entry->readOnly && !entry->dirty) {
+	    DEBUG(dbgAddr, "First write to clean page at " << virtAddr);
+	    return ReadOnlyException;		// the kernel marks the page
+						// dirty, and reloads the entry
+	}
     }
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
@@ -236,7 +293,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
+    if (pageFrame >= (unsigned) NumPhysPages) { 
 	DEBUG(dbgAddr, "Illegal pageframe " << pageFrame);
 	return BusErrorException;
     }
@@ -246,5 +303,14 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG(dbgAddr, "phys addr = " << *physAddr);
+
+    if (tlb == NULL && !debug->IsEnabled(dbgAddr)) {
+					// a TLB has to see (and count) every
+					// reference, and so does the trace
+	CachedTranslation *cached = &translations[vpn % TranslationCacheSize];
+	cached->virtualPage = vpn;
+	cached->frame = &mainMemory[pageFrame * PageSize];
+	cached->writable = entry->dirty && !entry->readOnly;
+    }
     return NoException;
 }
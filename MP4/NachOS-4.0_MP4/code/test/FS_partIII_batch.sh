@@ -0,0 +1 @@
+../build.linux/nachos -f -batch FS_partIII.script
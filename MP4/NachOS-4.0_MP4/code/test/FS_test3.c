@@ -0,0 +1,52 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// vectored and positional I/O: four 8-byte records in one trap each way
+	char rec[4][8];
+	char back[4][8];
+	char one[8];
+	IoVec vec[4];
+	OpenFileId fid;
+	int i, j, count, success;
+
+	success = Create("/file3", 32);
+	if (success != 1) MSG("Failed on creating file");
+	fid = Open("/file3");
+	if (fid <= 0) MSG("Failed on opening file");
+	for (i = 0; i < 4; ++i) {
+		for (j = 0; j < 8; ++j)
+			rec[i][j] = 'a' + i * 8 + j % 26;
+		vec[i].base = rec[i];
+		vec[i].len = 8;
+	}
+	count = WriteV(vec, 4, fid);
+	if (count != 32) MSG("Failed on WriteV");
+
+	// overwrite record 2 in place, without moving the seek position
+	for (j = 0; j < 8; ++j)
+		one[j] = 'Z';
+	count = PWrite(one, 8, 16, fid);
+	if (count != 8) MSG("Failed on PWrite");
+	for (j = 0; j < 8; ++j)
+		rec[2][j] = 'Z';
+
+	count = PRead(one, 8, 8, fid);
+	if (count != 8) MSG("Failed on PRead");
+	for (j = 0; j < 8; ++j)
+		if (one[j] != rec[1][j]) MSG("Failed: PRead wrong result");
+
+	if (Seek(0, fid) != 1) MSG("Failed on Seek");
+	for (i = 0; i < 4; ++i)
+		vec[i].base = back[i];
+	count = ReadV(vec, 4, fid);
+	if (count != 32) MSG("Failed on ReadV");
+	for (i = 0; i < 4; ++i)
+		for (j = 0; j < 8; ++j)
+			if (back[i][j] != rec[i][j]) MSG("Failed: ReadV wrong result");
+
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -0,0 +1,35 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// memory-mapped file: fill through the mapping, read back with Read
+	char back[200];
+	char *map;
+	OpenFileId fid;
+	int i, count, success;
+
+	success = Create("/file4", 200);
+	if (success != 1) MSG("Failed on creating file");
+	fid = Open("/file4");
+	if (fid <= 0) MSG("Failed on opening file");
+	map = (char *) Mmap(fid, 0, 200);
+	if ((int) map < 0) MSG("Failed on Mmap");
+	for (i = 0; i < 200; ++i)
+		map[i] = 'a' + i % 26;
+	if (Munmap(map) != 1) MSG("Failed on Munmap");
+
+	count = Read(back, 200, fid);
+	if (count != 200) MSG("Failed on reading file");
+	for (i = 0; i < 200; ++i)
+		if (back[i] != 'a' + i % 26) MSG("Failed: mapped writes lost");
+
+	// a second mapping of page 1 sees what the first one wrote
+	map = (char *) Mmap(fid, 128, 72);
+	if ((int) map < 0) MSG("Failed on Mmap");
+	if (map[0] != 'a' + 128 % 26) MSG("Failed: Mmap wrong result");
+
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -0,0 +1,49 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// rename and hard links: names change, the data is never copied
+	char buf[26];
+	OpenFileId fid;
+	int i, count, success;
+
+	success = Create("/file5", 26);
+	if (success != 1) MSG("Failed on creating file");
+	fid = Open("/file5");
+	if (fid <= 0) MSG("Failed on opening file");
+	for (i = 0; i < 26; ++i)
+		buf[i] = 'A' + i;
+	count = Write(buf, 26, fid);
+	if (count != 26) MSG("Failed on writing file");
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+
+	if (Rename("/file5", "/log5") != 1) MSG("Failed on Rename");
+	if (Open("/file5") >= 0) MSG("Failed: old name still there");
+	if (Link("/log5", "/link5") != 1) MSG("Failed on Link");
+	if (Link("/log5", "/link5") == 1) MSG("Failed: Link over an existing name");
+
+	// the data goes once the last name is removed
+	success = Remove("/log5");
+	fid = Open("/link5");
+	if (fid <= 0) MSG("Failed: second name lost");
+	count = Read(buf, 26, fid);
+	if (count != 26) MSG("Failed on reading file");
+	for (i = 0; i < 26; ++i)
+		if (buf[i] != 'A' + i) MSG("Failed: Read wrong result");
+
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+
+	// renaming onto a file replaces it
+	success = Create("/file5", 10);
+	if (success != 1) MSG("Failed on creating file");
+	if (Rename("/file5", "/link5") != 1) MSG("Failed on Rename over a file");
+	fid = Open("/link5");
+	if (fid <= 0) MSG("Failed: new file lost");
+	if (Read(buf, 26, fid) != 10) MSG("Failed: old file still there");
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -0,0 +1,36 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// stat: size, type, link count and times, without opening the file
+	char buf[26];
+	FileStat st;
+	OpenFileId fid;
+	int i, count, success, created;
+
+	success = Create("/file6", 26);
+	if (success != 1) MSG("Failed on creating file");
+	if (Stat("/file6", &st) != 1) MSG("Failed on Stat");
+	if (st.size != 26 || st.isDir || st.links != 1) MSG("Failed: Stat wrong result");
+	if (st.modifyTime != st.createTime) MSG("Failed: new file already modified");
+	created = st.createTime;
+
+	fid = Open("/file6");
+	if (fid <= 0) MSG("Failed on opening file");
+	for (i = 0; i < 26; ++i)
+		buf[i] = 'a' + i;
+	count = Write(buf, 26, fid);
+	if (count != 26) MSG("Failed on writing file");
+	if (Stat("/file6", &st) != 1) MSG("Failed on Stat");
+	if (st.modifyTime <= created) MSG("Failed: write didn't change the time");
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+	if (Close(fid) != -1) MSG("Failed: closed twice");
+
+	if (Link("/file6", "/link6") != 1) MSG("Failed on Link");
+	if (Stat("/link6", &st) != 1 || st.links != 2) MSG("Failed: wrong link count");
+	if (Stat("/", &st) != 1 || !st.isDir) MSG("Failed: root is not a directory");
+	if (Stat("/nofile6", &st) == 1) MSG("Failed: Stat of a missing file");
+	MSG("Passed! ^_^");
+	Halt();
+}
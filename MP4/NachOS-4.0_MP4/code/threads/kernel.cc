@@ -17,6 +17,8 @@
 #include "synchdisk.h"
 #include "post.h"
 #include "synchconsole.h"
+#include "profile.h"
+#include "checkpoint.h"
 
 //----------------------------------------------------------------------
 // Kernel::Kernel
@@ -28,10 +30,22 @@ Kernel::Kernel(int argc, char **argv)
 {
     randomSlice = FALSE; 
     debugUserProg = FALSE;
+    threadedCode = FALSE;
+    tlbSize = 0;                // no TLB: page tables
+    numCPUs = 1;
+    pageSize = DefaultPageSize;
+    memorySize = DefaultNumPhysPages * DefaultPageSize;
+    profileInterval = 0;        // no profiling
+    checkpointInterval = 0;     // no checkpoints
+    restoreFile = NULL;         // boot afresh
+    restorer = NULL;
+    ending = FALSE;
+    numThreads = 0;
     consoleIn = NULL;          // default is stdin
     consoleOut = NULL;         // default is stdout
 #ifndef FILESYS_STUB
     formatFlag = FALSE;
+    fileStatsFlag = FALSE;
 #endif
     reliability = 1;            // network reliability, default is 1.0
     hostName = 0;               // machine id, also UNIX socket name
@@ -39,6 +53,7 @@ Kernel::Kernel(int argc, char **argv)
 								
 	// MP4 mod tag
 	execfileNum = 0; // dummy operation to keep valgrind happy
+	threadNum = 0;
 								
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-rs") == 0) {
@@ -49,6 +64,51 @@ Kernel::Kernel(int argc, char **argv)
 	    	i++;
         } else if (strcmp(argv[i], "-s") == 0) {
             debugUserProg = TRUE;
+        } else if (strcmp(argv[i], "-tc") == 0) {
+            threadedCode = TRUE;
+        } else if (strcmp(argv[i], "-ps") == 0) {
+            ASSERT(i + 1 < argc);   // bytes in a page
+            pageSize = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-ms") == 0) {
+            ASSERT(i + 1 < argc);   // bytes of physical memory
+            memorySize = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-prof") == 0) {
+            ASSERT(i + 2 < argc);   // ticks between samples, host file
+            profileInterval = atoi(argv[i + 1]);
+            profileFile = argv[i + 2];
+            ASSERT(profileInterval > 0);
+            i += 2;
+        } else if (strcmp(argv[i], "-ckpt") == 0) {
+            ASSERT(i + 2 < argc);   // ticks between checkpoints, host file
+            checkpointInterval = atoi(argv[i + 1]);
+            checkpointFile = argv[i + 2];
+            ASSERT(checkpointInterval > 0);
+            i += 2;
+        } else if (strcmp(argv[i], "-restore") == 0) {
+            ASSERT(i + 1 < argc);   // host file
+            restoreFile = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-tlb") == 0) {
+            ASSERT(i + 3 < argc);   // entries, ways, policy
+            tlbSize = atoi(argv[i + 1]);
+            tlbWays = atoi(argv[i + 2]);
+            ASSERT(tlbWays >= 2 && tlbSize % tlbWays == 0);
+            if (strcmp(argv[i + 3], "lru") == 0)
+                tlbPolicy = LRUReplacement;
+            else if (strcmp(argv[i + 3], "fifo") == 0)
+                tlbPolicy = FIFOReplacement;
+            else if (strcmp(argv[i + 3], "random") == 0)
+                tlbPolicy = RandomReplacement;
+            else
+                ASSERTNOTREACHED();
+            i += 3;
+        } else if (strcmp(argv[i], "-cpus") == 0) {
+            ASSERT(i + 1 < argc);   // number of processors
+            numCPUs = atoi(argv[i + 1]);
+            ASSERT(numCPUs >= 1 && numCPUs <= MaxCPUs);
+            i++;
 		} else if (strcmp(argv[i], "-e") == 0) {
         	execfile[++execfileNum]= argv[++i];
 			cout << execfile[execfileNum] << "\n";
@@ -63,6 +123,8 @@ Kernel::Kernel(int argc, char **argv)
 #ifndef FILESYS_STUB
 		} else if (strcmp(argv[i], "-f") == 0) {
 	    	formatFlag = TRUE;
+		} else if (strcmp(argv[i], "-stats") == 0) {
+	    	fileStatsFlag = TRUE;
 #endif
         } else if (strcmp(argv[i], "-n") == 0) {
             ASSERT(i + 1 < argc);   // next argument is float
@@ -74,10 +136,16 @@ Kernel::Kernel(int argc, char **argv)
             i++;
         } else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-rs randomSeed]\n";
-	   		cout << "Partial usage: nachos [-s]\n";
+	   		cout << "Partial usage: nachos [-s] [-tc]\n";
+	   		cout << "Partial usage: nachos [-tlb entries ways lru|fifo|random]\n";
+	   		cout << "Partial usage: nachos [-ps pageSize] [-ms memorySize]\n";
+	   		cout << "Partial usage: nachos [-prof ticks profileFile]\n";
+	   		cout << "Partial usage: nachos [-ckpt ticks checkpointFile] [-restore checkpointFile]\n";
+	   		cout << "Partial usage: nachos [-cpus processors]\n";
             cout << "Partial usage: nachos [-ci consoleIn] [-co consoleOut]\n";
 #ifndef FILESYS_STUB
 	    	cout << "Partial usage: nachos [-nf]\n";
+	    	cout << "Partial usage: nachos [-stats]\n";
 #endif
             cout << "Partial usage: nachos [-n #] [-m #]\n";
 		}
@@ -106,15 +174,36 @@ Kernel::Initialize()
     interrupt = new Interrupt;		// start up interrupt handling
     scheduler = new Scheduler();	// initialize the ready queue
     alarm = new Alarm(randomSlice);	// start up time slicing
-    machine = new Machine(debugUserProg);
+    if (restoreFile != NULL)		// the machine has the checkpoint's
+	restorer = new Restorer(restoreFile, &pageSize, &memorySize);
+    SetMemorySize(pageSize, memorySize);
+    TLB *tlbs[MaxCPUs];			// one for each processor
+    for (int i = 0; i < numCPUs; i++)
+	tlbs[i] = tlbSize > 0 ? new TLB(tlbSize, tlbWays, tlbPolicy) : NULL;
+    machine = new Machine(debugUserProg, threadedCode, numCPUs, tlbs);
+    profiler = profileInterval > 0 ? 
+		new Profiler(profileInterval, profileFile) : NULL;
+    // checkpoints need one processor, no TLB and no random time
+    // slices (see checkpoint.h)
+    ASSERT((checkpointInterval <= 0 && restorer == NULL) ||
+		(numCPUs == 1 && tlbSize == 0 && !randomSlice));
+    checkpoint = checkpointInterval > 0 ?
+		new Checkpoint(checkpointInterval, checkpointFile) : NULL;
     synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
     synchDisk = new SynchDisk();    //
+    if (restorer != NULL)
+	restorer->RestoreDisk();	// before it is mounted
 #ifdef FILESYS_STUB
     fileSystem = new FileSystem();
 #else
+    openFileTable = new OpenFileTable();
+    fileSystem = NULL;			// OpenFile checks, while formatting
+    ASSERT(restorer == NULL || !formatFlag);
     fileSystem = new FileSystem(formatFlag);
 #endif // FILESYS_STUB
+    if (restorer != NULL)
+	restorer->RestoreFileSystem();
 
 	// MP4 mod tag
     /*
@@ -135,6 +224,7 @@ Kernel::Initialize()
 void
 Kernel::PrepareToEnd()
 {
+	ending = TRUE;
 	alarm->Disable();
 	synchConsoleIn->Disable();
 }
@@ -146,6 +236,20 @@ Kernel::PrepareToEnd()
 
 Kernel::~Kernel()
 {
+    if (tlbSize > 0)
+	stats->PrintTLB();		// Halt doesn't print the rest
+    if (numCPUs > 1)
+	stats->PrintCPUs(numCPUs);
+    delete profiler;			// writes the profile out
+    delete checkpoint;
+#ifndef FILESYS_STUB
+    if (fileStatsFlag)
+	fileSystem->PrintStats();	// the hot-file report
+#endif
+    delete fileSystem;		// may still have log to commit to disk
+#ifndef FILESYS_STUB
+    delete openFileTable;
+#endif
     delete stats;
     delete interrupt;
     delete scheduler;
@@ -154,13 +258,14 @@ Kernel::~Kernel()
     delete synchConsoleIn;
     delete synchConsoleOut;
     delete synchDisk;
-    delete fileSystem;
+    delete restorer;			// the threads' names
 	
 	// Mp4 mod tag
 	/*
     delete postOfficeIn;
     delete postOfficeOut;
     */
+	delete debug;		// last, the file system still logs on the way down
 	
     Exit(0);
 }
@@ -286,6 +391,11 @@ void ForkExecute(Thread *t)
 
 void Kernel::ExecAll()
 {
+	if (restorer != NULL) {		// resume the programs instead
+		ASSERT(execfileNum == 0);
+		restorer->RestoreThreads();
+		currentThread->Finish();
+	}
 	for (int i=1;i<=execfileNum;i++) {
 		int a = Exec(execfile[i]);
 	}
@@ -18,12 +18,16 @@
 #include "alarm.h"
 #include "filesys.h"
 #include "machine.h"
+#include "tlbsim.h"
 
 class PostOfficeInput;
 class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class Profiler;
+class Checkpoint;
+class Restorer;
 
 
 
@@ -64,13 +68,21 @@ class Kernel {
     SynchConsoleInput *synchConsoleIn;
     SynchConsoleOutput *synchConsoleOut;
     SynchDisk *synchDisk;
+#ifndef FILESYS_STUB
+    OpenFileTable *openFileTable;	// in-core headers of open files
+#endif
     FileSystem *fileSystem;     
     PostOfficeInput *postOfficeIn;
     PostOfficeOutput *postOfficeOut;
+    Profiler *profiler;		// samples user programs; NULL if not
+    Checkpoint *checkpoint;	// checkpoints the machine; NULL if not
+    int numThreads;		// threads in existence, finished or not
 
     int hostName;               // machine identifier
 
   private:
+    friend class Checkpoint;	// they save and restore the threads
+    friend class Restorer;
 
 	Thread* t[10];
 	char*   execfile[10];
@@ -78,11 +90,26 @@ class Kernel {
 	int threadNum;
     bool randomSlice;		// enable pseudo-random time slicing
     bool debugUserProg;         // single step user program
+    bool threadedCode;          // run user programs as threaded code
+    int tlbSize, tlbWays;       // TLB entries and associativity; no TLB
+                                // if tlbSize is 0
+    ReplacementPolicy tlbPolicy;
+    int numCPUs;                // processors the machine has
+    int pageSize, memorySize;   // in bytes; see SetMemorySize
+    int profileInterval;        // ticks between profile samples; no
+                                // profiling if 0
+    char *profileFile;          // host file to write the profile to
+    int checkpointInterval;     // ticks between checkpoints; none if 0
+    char *checkpointFile;       // host file to write them to
+    char *restoreFile;          // checkpoint to boot from, or NULL
+    Restorer *restorer;         // boots from it; NULL if not
+    bool ending;                // PrepareToEnd was called
     double reliability;         // likelihood messages are dropped
     char *consoleIn;            // file to read console input from
     char *consoleOut;           // file to send console output to
 #ifndef FILESYS_STUB
     bool formatFlag;          // format the disk if this is true
+    bool fileStatsFlag;       // print the I/O of each file at halt
 #endif
 };
 
@@ -3,9 +3,16 @@
 //	operating system kernel.  
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
-//              -s -x <nachos file> -ci <consoleIn> -co <consoleOut>
+//              -s -tc -tlb <entries> <ways> <policy>
+//              -ps <page size> -ms <memory size>
+//              -prof <ticks> <profile file> -cpus <processors>
+//              -ckpt <ticks> <checkpoint file> -restore <checkpoint file>
+//              -x <nachos file> -ci <consoleIn> -co <consoleOut>
 //              -f -cp <unix file> <nachos file>
-//              -p <nachos file> -r <nachos file> -l -D
+//              -cpr <unix directory> <nachos directory>
+//              -p <nachos file> -r <nachos file> -l -ll -D
+//              -mv <nachos file> <nachos file> -ln <nachos file> <nachos file>
+//              -batch <script file> -fsck -stats
 //              -n <network reliability> -m <machine id>
 //              -z -K -C -N
 //
@@ -13,6 +20,23 @@
 //    -rs causes Yield to occur at random (but repeatable) spots
 //    -z prints the copyright message
 //    -s causes user programs to be executed in single-step mode
+//    -tc runs user programs as threaded code, a basic block at a time,
+//       instead of interpreting them (the simulated time is the same)
+//    -tlb translates user addresses through a TLB of that many entries,
+//       in sets of "ways" (at least 2), replaced by "lru", "fifo" or
+//       "random", and prints its hit ratio at the end
+//    -ps sets the page size, in bytes (128 by default)
+//    -ms sets the size of physical memory, in bytes (16384 by default)
+//    -prof samples the call stack of the running user program every
+//       that many ticks, and writes the counts to a UNIX file at the end
+//       (see userprog/profile.h; coff2noff/noffprof symbolizes them)
+//    -cpus gives the machine that many processors (up to 8), which run
+//       user programs in turns of a few instructions each, and prints
+//       how each spent its time at the end (see Machine::RunCPUs)
+//    -ckpt saves the state of the whole machine to a UNIX file every
+//       that many ticks, when it can (see userprog/checkpoint.h)
+//    -restore boots from such a file, and resumes the programs that
+//       were running, instead of running any with -e
 //    -x runs a user program
 //    -ci specify file for console input (stdin is the default)
 //    -co specify file for console output (stdout is the default)
@@ -25,10 +49,24 @@
 //    Filesystem-related flags:
 //    -f forces the Nachos disk to be formatted
 //    -cp copies a file from UNIX to Nachos
+//    -cpr copies a whole UNIX directory tree into Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
+//    -rr removes a Nachos directory and everything in it
+//    -mv renames a Nachos file (or directory), without copying it
+//    -ln gives a Nachos file a second name (a hard link)
 //    -l lists the contents of the Nachos directory
+//    -ll lists them with their type, number of names, size, and the
+//       ticks at which each was created and last written
 //    -D prints the contents of the entire file system 
+//    -fsck checks the file system for leaked or doubly allocated
+//       sectors and dangling directory entries, and repairs them
+//    -batch runs every file system command in a UNIX script file
+//       (mkdir, cp, cpr, rm, ls, lr, cat, fsck -- one per line) in this one
+//       Nachos session, then prints the cost of each command
+//    -stats prints, when Nachos halts, the disk I/O done through each
+//       file and the total for each directory (the "stats" command of
+//       -batch prints it at that point)
 //
 //  Note: the file system flags are not used if the stub filesystem
 //        is being used
@@ -70,6 +108,13 @@ Cleanup(int x)
 //-------------------------------------------------------------------
 static const int TransferSize = 128;
 
+// Copy moves data into Nachos in runs of this many bytes, so that
+// each Write covers whole sectors of the (contiguous) new file
+static const int BulkTransferSize = 32 * TransferSize;
+
+// Longest UNIX or Nachos path name built by CopyTree
+static const int MaxPathLen = 256;
+
 
 #ifndef FILESYS_STUB
 //----------------------------------------------------------------------
@@ -107,9 +152,9 @@ Copy(char *from, char *to)
     openFile = kernel->fileSystem->Open(to);
     ASSERT(openFile != NULL);
     
-// Copy the data in TransferSize chunks
-    buffer = new char[TransferSize];
-    while ((amountRead=ReadPartial(fd, buffer, sizeof(char)*TransferSize)) > 0)
+// Copy the data in BulkTransferSize chunks
+    buffer = new char[BulkTransferSize];
+    while ((amountRead=ReadPartial(fd, buffer, sizeof(char)*BulkTransferSize)) > 0)
         openFile->Write(buffer, amountRead);    
     delete [] buffer;
 
@@ -165,6 +210,201 @@ CreateDirectory(char *name)
     }
 }
 
+#ifndef FILESYS_STUB
+//-------------------------------------------------------------------
+// Constants used by "RunScript"
+//   The longest script line, and the most words on one line
+//-------------------------------------------------------------------
+static const int MaxScriptLine = 512;
+static const int MaxScriptArgs = 3;
+
+//----------------------------------------------------------------------
+// CopyTree
+//      Copy the UNIX directory "from", and everything below it, to the
+//	Nachos directory "to" (created if need be).  Entries whose names
+//	are too long for a Nachos directory are skipped.
+//----------------------------------------------------------------------
+
+static void
+CopyTree(char *from, char *to)
+{
+    void *dir;
+    char *entry;
+    char fromPath[MaxPathLen], toPath[MaxPathLen];
+
+    if ((dir = OpenDir(from)) == NULL) {
+        printf("CopyTree: couldn't open input directory %s\n", from);
+        return;
+    }
+    if (strcmp(to, "/") != 0)
+        (void) kernel->fileSystem->CreateDirectory(to);	// may already exist
+
+    while ((entry = ReadDir(dir)) != NULL) {
+        if (strcmp(entry, ".") == 0 || strcmp(entry, "..") == 0)
+            continue;
+        if (strlen(entry) > FileNameMaxLen || 
+		strlen(from) + strlen(entry) + 2 > MaxPathLen ||
+		strlen(to) + strlen(entry) + 2 > MaxPathLen) {
+            printf("CopyTree: skipping %s/%s, name too long\n", from, entry);
+            continue;
+        }
+        sprintf(fromPath, "%s/%s", from, entry);
+        sprintf(toPath, "%s/%s", (strcmp(to, "/") == 0) ? "" : to, entry);
+        if (IsDirectory(fromPath))
+            CopyTree(fromPath, toPath);
+        else
+            Copy(fromPath, toPath);
+    }
+    CloseDir(dir);
+}
+
+//----------------------------------------------------------------------
+// RunScript
+//      Run the file system commands in the UNIX file "name", one
+//	command per line, in this single Nachos session.  Booting
+//	Nachos once per command re-reads the bitmap and directory
+//	cold every time; here they stay open across the whole script.
+//
+//	Each line is one of
+//	    mkdir <nachos dir>
+//	    cp <unix file> <nachos file>
+//	    rm <nachos file>		rm -r <nachos dir>
+//	    mv <nachos file> <nachos file>	ln <nachos file> <nachos file>
+//	    ls <nachos dir>		lr <nachos dir>	ll <nachos dir>
+//	    cat <nachos file>
+//	    snapshot <name>		take a snapshot of the whole tree
+//	    mount <name>		look names up in a snapshot, read-only
+//	    mount			back to the live file system
+//	    stats			print the I/O done through each file
+//	Blank lines and lines starting with '#' are skipped.
+//
+//	After the script finishes, print the simulated time and the
+//	number of disk reads and writes each command took.
+//----------------------------------------------------------------------
+
+static void
+RunScript(char *name)
+{
+    int fd, length, numLines, i;
+    char *script, *line;
+    char **commands;
+    int *ticks, *reads, *writes;
+    Statistics *stats = kernel->stats;
+
+    if ((fd = OpenForReadWrite(name, FALSE)) < 0) {
+        printf("RunScript: couldn't open script file %s\n", name);
+        return;
+    }
+    Lseek(fd, 0, 2);
+    length = Tell(fd);
+    Lseek(fd, 0, 0);
+    script = new char[length + 1];
+    Read(fd, script, length);
+    script[length] = '\0';
+    Close(fd);
+
+    numLines = 1;
+    for (i = 0; i < length; i++)
+        if (script[i] == '\n')
+            numLines++;
+    commands = new char *[numLines];
+    ticks = new int[numLines];
+    reads = new int[numLines];
+    writes = new int[numLines];
+
+    numLines = 0;
+    for (line = script; line != NULL; ) {
+        char *next = strchr(line, '\n');
+        char *argv[MaxScriptArgs];
+        char buf[MaxScriptLine];
+        int argc = 0, startTicks, startReads, startWrites;
+        char *p;
+
+        if (next != NULL)
+            *next++ = '\0';
+        // split the line into words; the file system mangles path
+        // names (strtok), so work on a copy and keep "line" intact
+        memset(buf, 0, sizeof(buf));
+        strncpy(buf, line, MaxScriptLine - 1);
+        for (p = buf; *p != '\0' && argc < MaxScriptArgs; ) {
+            while (*p == ' ' || *p == '\t' || *p == '\r')
+                *p++ = '\0';
+            if (*p == '\0')
+                break;
+            argv[argc++] = p;
+            while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r')
+                p++;
+        }
+        if (argc == 0 || argv[0][0] == '#') {
+            line = next;
+            continue;
+        }
+
+        startTicks = stats->totalTicks;
+        startReads = stats->numDiskReads;
+        startWrites = stats->numDiskWrites;
+        if (strcmp(argv[0], "mkdir") == 0 && argc == 2) {
+            CreateDirectory(argv[1]);
+        } else if (strcmp(argv[0], "cp") == 0 && argc == 3) {
+            Copy(argv[1], argv[2]);
+        } else if (strcmp(argv[0], "cpr") == 0 && argc == 3) {
+            CopyTree(argv[1], argv[2]);
+        } else if (strcmp(argv[0], "rm") == 0 && argc == 2) {
+            if (!kernel->fileSystem->Remove(argv[1]))
+                printf("RunScript: couldn't remove %s\n", argv[1]);
+        } else if (strcmp(argv[0], "rm") == 0 && argc == 3 && 
+			strcmp(argv[1], "-r") == 0) {
+            if (!kernel->fileSystem->RemoveTree(argv[2]))
+                printf("RunScript: couldn't remove %s\n", argv[2]);
+        } else if ((strcmp(argv[0], "ls") == 0 || 
+			strcmp(argv[0], "lr") == 0) && argc == 2) {
+            kernel->fileSystem->List(argv[1], argv[0][1] == 'r');
+        } else if (strcmp(argv[0], "ll") == 0 && argc == 2) {
+            kernel->fileSystem->ListLong(argv[1]);
+        } else if (strcmp(argv[0], "cat") == 0 && argc == 2) {
+            Print(argv[1]);
+        } else if (strcmp(argv[0], "mv") == 0 && argc == 3) {
+            if (!kernel->fileSystem->Rename(argv[1], argv[2]))
+                printf("RunScript: couldn't rename %s\n", argv[1]);
+        } else if (strcmp(argv[0], "ln") == 0 && argc == 3) {
+            if (!kernel->fileSystem->Link(argv[1], argv[2]))
+                printf("RunScript: couldn't link %s\n", argv[1]);
+        } else if (strcmp(argv[0], "fsck") == 0 && argc == 1) {
+            kernel->fileSystem->Check();
+        } else if (strcmp(argv[0], "stats") == 0 && argc == 1) {
+            kernel->fileSystem->PrintStats();
+        } else if (strcmp(argv[0], "snapshot") == 0 && argc == 2) {
+            if (!kernel->fileSystem->Snapshot(argv[1]))
+                printf("RunScript: couldn't take snapshot %s\n", argv[1]);
+        } else if (strcmp(argv[0], "mount") == 0 && argc <= 2) {
+            if (!kernel->fileSystem->Mount(argc == 2 ? argv[1] : NULL))
+                printf("RunScript: no snapshot %s\n", argv[1]);
+        } else {
+            printf("RunScript: bad command \"%s\"\n", line);
+            line = next;
+            continue;
+        }
+        commands[numLines] = line;
+        ticks[numLines] = stats->totalTicks - startTicks;
+        reads[numLines] = stats->numDiskReads - startReads;
+        writes[numLines] = stats->numDiskWrites - startWrites;
+        numLines++;
+        line = next;
+    }
+
+    printf("\n%d commands from %s:\n", numLines, name);
+    for (i = 0; i < numLines; i++)
+        printf("%10d ticks %6d reads %6d writes  %s\n", ticks[i], 
+		reads[i], writes[i], commands[i]);
+
+    delete [] commands;
+    delete [] ticks;
+    delete [] reads;
+    delete [] writes;
+    delete [] script;
+}
+#endif // FILESYS_STUB
+
 //----------------------------------------------------------------------
 // main
 // 	Bootstrap the operating system kernel.  
@@ -191,16 +431,25 @@ main(int argc, char **argv)
 #ifndef FILESYS_STUB
     char *copyUnixFileName = NULL;    // UNIX file to be copied into Nachos
     char *copyNachosFileName = NULL;  // name of copied file in Nachos
+    char *copyUnixDirName = NULL;     // UNIX directory tree to be copied
+    char *copyNachosDirName = NULL;   // where it goes in Nachos
     char *printFileName = NULL; 
     char *removeFileName = NULL;
+    char *renameFrom = NULL, *renameTo = NULL;	// -mv
+    char *linkFrom = NULL, *linkTo = NULL;	// -ln
     bool dirListFlag = false;
     bool dumpFlag = false;
+    bool fsckFlag = false;
 	// MP4 mod tag
 	char *createDirectoryName = NULL;
 	char *listDirectoryName = NULL;
 	bool mkdirFlag = false;
 	bool recursiveListFlag = false;
+	bool longListFlag = false;
 	bool recursiveRemoveFlag = false;
+	char *scriptFileName = NULL;
+	char *snapshotName = NULL;	// snapshot to take
+	char *mountName = NULL;		// snapshot to mount read-only
 #endif //FILESYS_STUB
 
     // some command line arguments are handled here.
@@ -236,6 +485,12 @@ main(int argc, char **argv)
 	    copyNachosFileName = argv[i + 2];
 	    i += 2;
 	}
+	else if (strcmp(argv[i], "-cpr") == 0) {
+	    ASSERT(i + 2 < argc);
+	    copyUnixDirName = argv[i + 1];
+	    copyNachosDirName = argv[i + 2];
+	    i += 2;
+	}
 	else if (strcmp(argv[i], "-p") == 0) {
 	    ASSERT(i + 1 < argc);
 	    printFileName = argv[i + 1];
@@ -246,6 +501,18 @@ main(int argc, char **argv)
 	    removeFileName = argv[i + 1];
 	    i++;
 	}
+	else if (strcmp(argv[i], "-mv") == 0) {
+	    ASSERT(i + 2 < argc);
+	    renameFrom = argv[i + 1];
+	    renameTo = argv[i + 2];
+	    i += 2;
+	}
+	else if (strcmp(argv[i], "-ln") == 0) {
+	    ASSERT(i + 2 < argc);
+	    linkFrom = argv[i + 1];
+	    linkTo = argv[i + 2];
+	    i += 2;
+	}
 	else if (strcmp(argv[i], "-rr") == 0) {
 		// MP4 mod tag
 		ASSERT(i + 1 < argc);
@@ -269,6 +536,13 @@ main(int argc, char **argv)
 		recursiveListFlag = true;
 		i++;
 	}
+	else if (strcmp(argv[i], "-ll") == 0) {
+		ASSERT(i + 1 < argc);
+		listDirectoryName = argv[i + 1];
+		dirListFlag = true;
+		longListFlag = true;
+		i++;
+	}
 	else if (strcmp(argv[i], "-mkdir") == 0) {
 		// MP4 mod tag
 		ASSERT(i + 1 < argc);
@@ -279,6 +553,24 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-D") == 0) {
 	    dumpFlag = true;
 	}
+	else if (strcmp(argv[i], "-fsck") == 0) {
+	    fsckFlag = true;
+	}
+	else if (strcmp(argv[i], "-batch") == 0) {
+	    ASSERT(i + 1 < argc);
+	    scriptFileName = argv[i + 1];
+	    i++;
+	}
+	else if (strcmp(argv[i], "-snapshot") == 0) {
+	    ASSERT(i + 1 < argc);
+	    snapshotName = argv[i + 1];
+	    i++;
+	}
+	else if (strcmp(argv[i], "-mount") == 0) {
+	    ASSERT(i + 1 < argc);
+	    mountName = argv[i + 1];
+	    i++;
+	}
 #endif //FILESYS_STUB
 	else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-z -d debugFlags]\n";
@@ -286,8 +578,13 @@ main(int argc, char **argv)
 	    cout << "Partial usage: nachos [-K] [-C] [-N]\n";
 #ifndef FILESYS_STUB
             cout << "Partial usage: nachos [-cp UnixFile NachosFile]\n";
+            cout << "Partial usage: nachos [-cpr UnixDir NachosDir]\n";
             cout << "Partial usage: nachos [-p fileName] [-r fileName]\n";
-            cout << "Partial usage: nachos [-l] [-D]\n";
+            cout << "Partial usage: nachos [-mv from to] [-ln from to]\n";
+            cout << "Partial usage: nachos [-l] [-ll dirName] [-D]\n";
+            cout << "Partial usage: nachos [-batch scriptFile]\n";
+            cout << "Partial usage: nachos [-fsck]\n";
+            cout << "Partial usage: nachos [-snapshot name] [-mount name]\n";
 #endif //FILESYS_STUB
 	}
 
@@ -315,25 +612,53 @@ main(int argc, char **argv)
     }
 
 #ifndef FILESYS_STUB
+    if (fsckFlag) {
+		kernel->fileSystem->Check();
+    }
+    if (mountName != NULL && !kernel->fileSystem->Mount(mountName)) {
+		printf("No snapshot %s; the snapshots are:\n", mountName);
+		kernel->fileSystem->ListSnapshots();
+    }
     if (removeFileName != NULL) {
-		kernel->fileSystem->Remove(removeFileName);
+		if (recursiveRemoveFlag)
+			kernel->fileSystem->RemoveTree(removeFileName);
+		else
+			kernel->fileSystem->Remove(removeFileName);
     }
     if (copyUnixFileName != NULL && copyNachosFileName != NULL) {
 		Copy(copyUnixFileName,copyNachosFileName);
     }
+    if (renameFrom != NULL && !kernel->fileSystem->Rename(renameFrom, renameTo)) {
+		printf("Couldn't rename %s to %s\n", renameFrom, renameTo);
+    }
+    if (linkFrom != NULL && !kernel->fileSystem->Link(linkFrom, linkTo)) {
+		printf("Couldn't link %s to %s\n", linkTo, linkFrom);
+    }
+    if (copyUnixDirName != NULL && copyNachosDirName != NULL) {
+		CopyTree(copyUnixDirName, copyNachosDirName);
+    }
     if (dumpFlag) {
 		kernel->fileSystem->Print();
     }
     if (dirListFlag) {
-		kernel->fileSystem->List(listDirectoryName, recursiveListFlag);
+		if (longListFlag)
+			kernel->fileSystem->ListLong(listDirectoryName);
+		else
+			kernel->fileSystem->List(listDirectoryName, recursiveListFlag);
     }
 	if (mkdirFlag) {
 		// MP4 mod tag
 		CreateDirectory(createDirectoryName);
 	}
+    if (snapshotName != NULL && !kernel->fileSystem->Snapshot(snapshotName)) {
+		printf("Couldn't take snapshot %s\n", snapshotName);
+    }
     if (printFileName != NULL) {
       Print(printFileName);
     }
+    if (scriptFileName != NULL) {
+      RunScript(scriptFileName);
+    }
 #endif // FILESYS_STUB
 
     // finally, run an initial user program if requested to do so
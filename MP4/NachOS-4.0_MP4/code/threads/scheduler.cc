@@ -4,7 +4,15 @@
 //
 // 	These routines assume that interrupts are already disabled.
 //	If interrupts are disabled, we can assume mutual exclusion
-//	(since we are on a uniprocessor).
+//	(since the kernel only runs on one processor at a time).
+//
+//	The machine may have more than one processor (-cpus), each
+//	running a thread of its own, or none.  They take turns (see
+//	Machine::RunCPUs); at the end of each, NextCPU switches to the
+//	next one, and to its thread.  A processor whose thread blocks
+//	runs a ready thread if there is one, as usual; if not, it goes
+//	idle, and we go on with another processor's thread.  Ready
+//	threads are given to idle processors when their turn comes.
 //
 // 	NOTE: We can't use Locks to provide mutual exclusion here, since
 // 	if we needed to wait for a lock, and the lock was busy, we would 
@@ -33,6 +41,10 @@ Scheduler::Scheduler()
 { 
     readyList = new List<Thread *>; 
     toBeDestroyed = NULL;
+    for (int i = 0; i < MaxCPUs; i++)
+	running[i] = NULL;
+    running[0] = kernel->currentThread;	// main, on the first processor
+    roundOver = FALSE;
 } 
 
 //----------------------------------------------------------------------
@@ -91,6 +103,12 @@ Scheduler::FindNextToRun ()
 //
 //      Note: we assume the state of the previously running thread has
 //	already been changed from running to blocked or ready (depending).
+//
+//	"nextThread" may also be another processor's thread (from
+//	FindOtherCPU), when there is no ready thread for this processor:
+//	it goes idle, and we go on with that processor.  If it was the
+//	last to have its turn, the round is over; the thread advances
+//	simulated time once it is back at the end of its turn in NextCPU.
 // Side effect:
 //	The global variable kernel->currentThread becomes nextThread.
 //
@@ -120,6 +138,17 @@ Scheduler::Run (Thread *nextThread, bool finishing)
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
 
+    Machine *machine = kernel->machine;
+    if (nextThread->getStatus() == RUNNING) {	// leave this processor idle
+	int which = CPUOf(nextThread);
+	if (which < machine->cpu)
+	    roundOver = TRUE;
+	running[machine->cpu] = NULL;
+	machine->SwitchCPU(which);
+    } else {
+	running[machine->cpu] = nextThread;
+	kernel->stats->cpuDispatches[machine->cpu]++;
+    }
     kernel->currentThread = nextThread;  // switch to the next thread
     nextThread->setStatus(RUNNING);      // nextThread is now running
     
@@ -166,6 +195,117 @@ Scheduler::CheckToBeDestroyed()
     }
 }
  
+//----------------------------------------------------------------------
+// Scheduler::NextCPU
+// 	Called by the machine at the end of the running processor's turn,
+//	with interrupts enabled.  Switch to the next processor that has a
+//	thread, or to the next idle one if a thread is ready, giving it
+//	that thread; return when this processor's next turn comes.
+//
+//	Once we get back to where we started, every processor has had
+//	its turn, and simulated time advances (Machine::EndRound).  Then
+//	we look again: an interrupt may have made a thread ready.
+//
+//	The processors' threads are suspended here, but a thread that
+//	was ready is suspended in Run: we switch to it with interrupts
+//	disabled, in the kernel, as it expects.  Switching itself takes
+//	no time, so interrupts are turned back on with ChangeLevel rather
+//	than SetLevel, which would advance simulated time.
+//----------------------------------------------------------------------
+
+void
+Scheduler::NextCPU()
+{
+    Machine *machine = kernel->machine;
+    Interrupt *interrupt = kernel->interrupt;
+    Thread *oldThread = kernel->currentThread;
+    Thread *nextThread;
+    int which = NextBusyCPU();
+
+    if (which == -1 || which < machine->cpu) {	// the round is over
+	machine->EndRound();
+	which = NextBusyCPU();
+	if (which == -1)
+	    return;			// we're the only one with a thread
+    }
+
+    interrupt->ChangeLevel(IntOn, IntOff);
+    interrupt->setStatus(SystemMode);
+    oldThread->CheckOverflow();
+    machine->SwitchCPU(which);
+    if (running[which] == NULL) {	// an idle processor: dispatch
+	nextThread = readyList->RemoveFront();
+	nextThread->setStatus(RUNNING);
+	running[which] = nextThread;
+	kernel->stats->cpuDispatches[which]++;
+    } else
+	nextThread = running[which];
+    kernel->currentThread = nextThread;
+
+    DEBUG(dbgThread, "Switching from: " << oldThread->getName() << " to: " << nextThread->getName() << " on processor " << which);
+    SWITCH(oldThread, nextThread);
+    // we're back, on whichever processor runs us now
+
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    interrupt->ChangeLevel(IntOff, IntOn);
+    interrupt->setStatus(UserMode);
+    CheckToBeDestroyed();
+    if (roundOver) {			// see Run
+	roundOver = FALSE;
+	machine->EndRound();
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::FindOtherCPU
+// 	Return the thread of the next processor after the running one
+//	that has a thread; NULL if none does.  Only called when no thread
+//	is ready (otherwise we might return an idle processor).
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::FindOtherCPU()
+{
+    int which = NextBusyCPU();
+
+    return (which == -1) ? NULL : running[which];
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextBusyCPU
+// 	Return the next processor after the running one, in turn order,
+//	that has a thread to run, or is idle while one is ready; -1 if
+//	there is none.
+//----------------------------------------------------------------------
+
+int
+Scheduler::NextBusyCPU()
+{
+    Machine *machine = kernel->machine;
+
+    for (int i = 1; i < machine->numCPUs; i++) {
+	int which = (machine->cpu + i) % machine->numCPUs;
+	if (running[which] != NULL || !readyList->IsEmpty())
+	    return which;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::CPUOf
+// 	Return the processor running "thread".
+//----------------------------------------------------------------------
+
+int
+Scheduler::CPUOf(Thread *thread)
+{
+    for (int i = 0; i < kernel->machine->numCPUs; i++)
+	if (running[i] == thread)
+	    return i;
+    ASSERTNOTREACHED();
+    return -1;
+}
+
 //----------------------------------------------------------------------
 // Scheduler::Print
 // 	Print the scheduler state -- in other words, the contents of
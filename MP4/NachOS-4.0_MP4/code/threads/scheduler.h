@@ -12,6 +12,7 @@
 #include "copyright.h"
 #include "list.h"
 #include "thread.h"
+#include "stats.h"
 
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
@@ -30,6 +31,13 @@ class Scheduler {
     				// Cause nextThread to start running
     void CheckToBeDestroyed();// Check if thread that had been
     				// running needs to be deleted
+
+    void NextCPU();		// The running processor's turn is over;
+				// run the next one, if there is another
+    Thread *FindOtherCPU();	// The thread of another processor, if
+				// any has one
+    List<Thread *> *getReadyList() { return readyList; }
+				// The threads ready to run, in order
     void Print();		// Print contents of ready list
     
     // SelfTest for scheduler is implemented in class Thread
@@ -39,6 +47,13 @@ class Scheduler {
 				// but not running
     Thread *toBeDestroyed;	// finishing thread to be destroyed
     				// by the next thread that runs
+    Thread *running[MaxCPUs];	// running[i] is the thread processor
+				// "i" is running; NULL if it is idle
+    bool roundOver;		// every processor has had its turn, and
+				// time has yet to advance (see Run)
+    int NextBusyCPU();		// The next processor with a thread to
+				// run, or to be given one; -1 if none
+    int CPUOf(Thread *thread);	// The processor running "thread"
 };
 
 #endif // SCHEDULER_H
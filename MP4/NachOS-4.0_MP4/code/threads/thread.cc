@@ -46,6 +46,9 @@ Thread::Thread(char* threadName, int threadID)
 					// of machine registers
     }
     space = NULL;
+    openFiles = new FileDescriptorTable();
+    preempted = FALSE;
+    kernel->numThreads++;
 }
 
 //----------------------------------------------------------------------
@@ -66,6 +69,8 @@ Thread::~Thread()
     ASSERT(this != kernel->currentThread);
     if (stack != NULL)
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    delete openFiles;
+    kernel->numThreads--;
 }
 
 //----------------------------------------------------------------------
@@ -170,6 +175,8 @@ Thread::Begin ()
 void
 Thread::Finish ()
 {
+    delete openFiles;		// closing a file may write its header
+    openFiles = NULL;		// back, so do it while we can still wait
     (void) kernel->interrupt->SetLevel(IntOff);		
     ASSERT(this == kernel->currentThread);
     
@@ -227,7 +234,8 @@ Thread::Yield ()
 //	we have no thread to run.  "Interrupt::Idle" is called
 //	to signify that we should idle the CPU until the next I/O interrupt
 //	occurs (the only thing that could cause a thread to become
-//	ready to run).
+//	ready to run) -- unless another processor is running a thread:
+//	then this one is left idle, and we go on with that thread.
 //
 //	NOTE: we assume interrupts are already disabled, because it
 //	is called from the synchronization routines which must
@@ -248,6 +256,8 @@ Thread::Sleep (bool finishing)
     status = BLOCKED;
 	//cout << "debug Thread::Sleep " << name << "wait for Idle\n";
     while ((nextThread = kernel->scheduler->FindNextToRun()) == NULL) {
+		if ((nextThread = kernel->scheduler->FindOtherCPU()) != NULL)
+			break;		// another processor still has work
 		kernel->PrepareToEnd();
 		kernel->interrupt->Idle();	// no one to run, wait for an interrupt
 	}    
@@ -396,6 +406,30 @@ Thread::RestoreUserState()
 	kernel->machine->WriteRegister(i, userRegisters[i]);
 }
 
+//----------------------------------------------------------------------
+// Thread::Save
+//	Write the user-level CPU state, as last saved, into a checkpoint
+//	open as host file "fd".
+//----------------------------------------------------------------------
+
+void
+Thread::Save(int fd)
+{
+    WriteFile(fd, (char *) userRegisters, sizeof(userRegisters));
+}
+
+//----------------------------------------------------------------------
+// Thread::Restore
+//	Read back the user-level CPU state Save wrote; RestoreUserState
+//	then loads it into the machine.
+//----------------------------------------------------------------------
+
+void
+Thread::Restore(int fd)
+{
+    Read(fd, (char *) userRegisters, sizeof(userRegisters));
+}
+
 
 //----------------------------------------------------------------------
 // SimpleThread
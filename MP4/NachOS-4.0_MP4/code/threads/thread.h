@@ -42,6 +42,7 @@
 #include "sysdep.h"
 #include "machine.h"
 #include "addrspace.h"
+#include "fdtable.h"
 
 // CPU register state to be saved on context switch.  
 // The x86 needs to save only a few registers, 
@@ -129,8 +130,13 @@ class Thread {
   public:
     void SaveUserState();		// save user-level register state
     void RestoreUserState();		// restore user-level register state
+    void Save(int fd);			// write the saved user-level state
+    void Restore(int fd);		// into a checkpoint, or read it back
 
     AddrSpace *space;			// User code this thread is running.
+    FileDescriptorTable *openFiles;	// Files the user code has open
+    bool preempted;			// The timer took the CPU from its
+					// user code, and it hasn't run since
 };
 
 // external function, dummy routine whose sole job is to call Thread::Print
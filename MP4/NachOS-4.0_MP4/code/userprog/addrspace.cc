@@ -20,6 +20,9 @@
 #include "addrspace.h"
 #include "machine.h"
 #include "noff.h"
+#include "tlbsim.h"
+
+static int nextASID = 0;		// tag for the next address space
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -76,6 +79,12 @@ AddrSpace::AddrSpace()
 	pageTable[i].dirty = FALSE;
 	pageTable[i].readOnly = FALSE;  
     }
+    numPages = mapEnd = 0;
+    for (int i = 0; i < MaxMappings; i++)
+	mappings[i] = NULL;
+    asid = nextASID;			// tags are reused, so drop whatever
+    nextASID = (nextASID + 1) % NumASIDs;	// the last owner left
+    kernel->machine->FlushSpace(asid);
     
     // zero out the entire address space
     bzero(kernel->machine->mainMemory, MemorySize);
@@ -83,11 +92,13 @@ AddrSpace::AddrSpace()
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.
+// 	Dealloate an address space, writing back anything still mapped.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
+   UnmapAll();
+   kernel->machine->FlushSpace(asid);
    delete pageTable;
 }
 
@@ -134,11 +145,17 @@ AddrSpace::Load(char *fileName)
 #endif
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
+    mapEnd = numPages;
 
-    ASSERT(numPages <= NumPhysPages);		// check we're not trying
+    if (numPages > (unsigned) NumPhysPages) {	// check we're not trying
 						// to run anything too big --
 						// at least until we have
 						// virtual memory
+	cerr << fileName << " needs " << size << " bytes of memory, "
+		<< "more than the " << MemorySize << " there are (see -ms)\n";
+	delete executable;
+	return FALSE;
+    }
 
     DEBUG(dbgAddr, "Initializing address space: " << numPages << ", " << size);
 
@@ -251,13 +268,64 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table, and
+//	to forget the translations it cached from the last one.  With a
+//	TLB, just tell it which entries are ours: it can keep the rest.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
+    if (kernel->machine->tlb != NULL) {
+	kernel->machine->tlb->SetSpace(asid);
+	return;
+    }
     kernel->machine->pageTable = pageTable;
-    kernel->machine->pageTableSize = numPages;
+    kernel->machine->pageTableSize = mapEnd;
+    kernel->machine->FlushTranslations();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::HasMappings
+// 	Return TRUE if a file is mapped into the address space.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::HasMappings()
+{
+    for (int slot = 0; slot < MaxMappings; slot++)
+	if (mappings[slot] != NULL)
+	    return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Save
+// 	Write the size of the address space and its page table into a
+//	checkpoint open as host file "fd".  The contents of the pages are
+//	in main memory, which the checkpoint has too.  Mapped files can't
+//	be saved: there must be none.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Save(int fd)
+{
+    ASSERT(!HasMappings());
+    WriteFile(fd, (char *) &numPages, sizeof(numPages));
+    WriteFile(fd, (char *) &mapEnd, sizeof(mapEnd));
+    WriteFile(fd, (char *) pageTable, NumPhysPages * sizeof(TranslationEntry));
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Restore
+// 	Read back what Save wrote, into a new address space.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Restore(int fd)
+{
+    Read(fd, (char *) &numPages, sizeof(numPages));
+    Read(fd, (char *) &mapEnd, sizeof(mapEnd));
+    Read(fd, (char *) pageTable, NumPhysPages * sizeof(TranslationEntry));
 }
 
 
@@ -277,12 +345,16 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
     unsigned int      vpn    = vaddr / PageSize;
     unsigned int      offset = vaddr % PageSize;
 
-    if(vpn >= numPages) {
+    if(vpn >= mapEnd) {
         return AddressErrorException;
     }
 
     pte = &pageTable[vpn];
 
+    if(!pte->valid) {
+        return PageFaultException;
+    }
+
     if(isReadWrite && pte->readOnly) {
         return ReadOnlyException;
     }
@@ -303,7 +375,7 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
 
     *paddr = pfn*PageSize + offset;
 
-    ASSERT((*paddr < MemorySize));
+    ASSERT((*paddr < (unsigned) MemorySize));
 
     //cerr << " -- AddrSpace::Translate(): vaddr: " << vaddr <<
     //  ", paddr: " << *paddr << "\n";
@@ -311,6 +383,283 @@ AddrSpace::Translate(unsigned int vaddr, unsigned int *paddr, int isReadWrite)
     return NoException;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::Map
+//  Map "length" bytes of "file", starting at byte "offset" (a multiple
+//  of PageSize), into the pages following the stack and any earlier
+//  mapping.  Nothing is read yet: the pages are marked invalid, and
+//  PageFault reads each one in the first time it is touched.  If the
+//  file is read-only (in a mounted snapshot), so are the pages.
+//
+//  The region keeps its own open of the file, so the caller may close
+//  "file" without affecting the mapping.  Since virtual pages are
+//  still mapped 1:1 onto physical pages, the region has to fit below
+//  NumPhysPages.
+//
+//  Return the virtual address of the region, or -1 on failure.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::Map(OpenFile *file, int offset, int length)
+{
+    Mapping *map;
+    int slot, pages;
+
+    if (offset < 0 || offset % PageSize != 0 || length <= 0)
+	return -1;
+    for (slot = 0; slot < MaxMappings; slot++)
+	if (mappings[slot] == NULL)
+	    break;
+    pages = divRoundUp(length, PageSize);
+    if (slot == MaxMappings || mapEnd + pages > (unsigned) NumPhysPages)
+	return -1;
+
+    map = new Mapping;
+    map->file = new OpenFile(file->HeaderSector());
+    if (file->IsReadOnly())
+	map->file->SetReadOnly();	// in a mounted snapshot
+    map->offset = offset;
+    map->length = length;
+    map->firstPage = mapEnd;
+    map->numPages = pages;
+    for (int i = map->firstPage; i < map->firstPage + pages; i++) {
+	pageTable[i].valid = FALSE;
+	pageTable[i].use = FALSE;
+	pageTable[i].dirty = FALSE;
+	pageTable[i].readOnly = map->file->IsReadOnly();
+    }
+    mappings[slot] = map;
+    mapEnd += pages;
+    kernel->machine->pageTableSize = mapEnd;	// we are the running space
+    TranslationsChanged();
+
+    DEBUG(dbgAddr, "Mapped " << length << " bytes at offset " << offset
+		<< " to page " << map->firstPage);
+    return map->firstPage * PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Unmap
+//  Write back the dirty pages of the region mapped at "addr", and take
+//  it out of the address space; touching it afterwards is an error.
+//  Return FALSE if nothing is mapped at "addr", or if a page could not
+//  be written back (the region is unmapped all the same).
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Unmap(int addr)
+{
+    Mapping *map;
+    int slot;
+    bool written;
+
+    for (slot = 0; slot < MaxMappings; slot++)
+	if (mappings[slot] != NULL && 
+		mappings[slot]->firstPage * PageSize == addr)
+	    break;
+    if (slot == MaxMappings)
+	return FALSE;
 
+    map = mappings[slot];
+    written = WriteBack(map);
+    for (int i = map->firstPage; i < map->firstPage + map->numPages; i++)
+	pageTable[i].valid = FALSE;
+    delete map->file;
+    delete map;
+    mappings[slot] = NULL;
+
+    // give back the pages at the end; holes in the middle stay invalid
+    mapEnd = numPages;
+    for (slot = 0; slot < MaxMappings; slot++)
+	if (mappings[slot] != NULL && mappings[slot]->firstPage + 
+		mappings[slot]->numPages > (int)mapEnd)
+	    mapEnd = mappings[slot]->firstPage + mappings[slot]->numPages;
+    kernel->machine->pageTableSize = mapEnd;
+    TranslationsChanged();
+
+    DEBUG(dbgAddr, "Unmapped region at " << addr);
+    return written;
+}
 
+//----------------------------------------------------------------------
+// AddrSpace::UnmapAll
+//  Unmap every region, writing its dirty pages back.  Called when the
+//  program exits or halts the machine.
+//----------------------------------------------------------------------
 
+void
+AddrSpace::UnmapAll()
+{
+    for (int slot = 0; slot < MaxMappings; slot++)
+	if (mappings[slot] != NULL)
+	    Unmap(mappings[slot]->firstPage * PageSize);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageFault
+//  Handle a page fault at "vaddr": if it falls in a mapped region,
+//  read the page in from the file (zero filling past the end of the
+//  region or the file) and mark it valid, so the faulting instruction
+//  can be retried.  Return FALSE if "vaddr" isn't mapped, or if the
+//  file returns less of the page than it holds.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::PageFault(int vaddr)
+{
+    int vpn = vaddr / PageSize;
+
+    for (int slot = 0; slot < MaxMappings; slot++) {
+	Mapping *map = mappings[slot];
+	TranslationEntry *entry;
+	char *frame;
+	int page, position, bytes, expected;
+
+	if (map == NULL || vpn < map->firstPage || 
+		vpn >= map->firstPage + map->numPages)
+	    continue;
+	entry = &pageTable[vpn];
+	frame = &(kernel->machine->mainMemory[entry->physicalPage * PageSize]);
+	page = vpn - map->firstPage;
+	position = map->offset + page * PageSize;
+	bytes = min(PageSize, map->length - page * PageSize);
+	expected = max(0, min(bytes, map->file->Length() - position));
+
+	bzero(frame, PageSize);
+	if (map->file->ReadAt(frame, bytes, position) < expected) {
+	    DEBUG(dbgAddr, "Short read of mapped page " << vpn);
+	    return FALSE;
+	}
+	entry->valid = TRUE;
+	entry->use = FALSE;
+	entry->dirty = FALSE;
+	TranslationsChanged();
+	DEBUG(dbgAddr, "Paged in mapped page " << vpn);
+	return TRUE;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::WriteBack
+//  Copy the pages of "map" that were written since they were read in
+//  back to the file.  Pages never touched are still invalid, and
+//  clean pages match the file already, so neither costs a write.
+//  Return FALSE if the file took less than all of some page (the disk
+//  is full); that page stays dirty.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::WriteBack(Mapping *map)
+{
+    bool written = TRUE;
+
+    for (int page = 0; page < map->numPages; page++) {
+	TranslationEntry *entry = &pageTable[map->firstPage + page];
+	int bytes = min(PageSize, map->length - page * PageSize);
+
+	if (!entry->valid || !entry->dirty)
+	    continue;
+	if (map->file->WriteAt(
+		&(kernel->machine->mainMemory[entry->physicalPage * PageSize]),
+		bytes, map->offset + page * PageSize) < bytes) {
+	    DEBUG(dbgAddr, "Short write of mapped page " << map->firstPage + page);
+	    written = FALSE;
+	    continue;
+	}
+	entry->dirty = FALSE;		// so writes have to set it again
+	TranslationsChanged();
+	DEBUG(dbgAddr, "Wrote back mapped page " << map->firstPage + page);
+    }
+    return written;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FaultIn
+//  Called before the kernel copies "size" bytes to ("toUser") or from
+//  the user buffer at "addr" for a system call.  The kernel goes
+//  straight to main memory, so read in the mapped pages of the buffer
+//  not touched yet, and mark them dirty if it is writing into them,
+//  so they get written back.
+//
+//  Return FALSE if the buffer isn't all in the address space, or part
+//  of it is read-only and "toUser".
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::FaultIn(int addr, int size, bool toUser)
+{
+    unsigned int first = (unsigned) addr / PageSize;
+    unsigned int last = ((unsigned) addr + size - 1) / PageSize;
+
+    if (addr < 0 || size < 0)
+	return FALSE;
+    for (unsigned int vpn = first; size > 0 && vpn <= last; vpn++) {
+	TranslationEntry *entry;
+
+	if (vpn >= mapEnd)
+	    return FALSE;
+	entry = &pageTable[vpn];
+	if (!entry->valid && !PageFault(vpn * PageSize))
+	    return FALSE;
+	if (toUser) {
+	    if (entry->readOnly)
+		return FALSE;
+	    entry->dirty = TRUE;	// the TLB may still hold a clean copy;
+					// that only costs an extra trap
+	}
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::TranslationsChanged
+//  Called whenever an entry of our page table changes: the machine
+//  may have a copy of it, in its translation cache or the TLB.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::TranslationsChanged()
+{
+    kernel->machine->FlushTranslations();
+    kernel->machine->FlushSpace(asid);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LoadTLB
+//  Handle a TLB miss at "vaddr": if its page is valid, load its page
+//  table entry into the TLB, so the instruction can be retried.
+//  Return FALSE if it isn't (a real page fault).
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::LoadTLB(int vaddr)
+{
+    unsigned int vpn = (unsigned) vaddr / PageSize;
+
+    if (vpn >= mapEnd || !pageTable[vpn].valid)
+	return FALSE;
+    pageTable[vpn].use = TRUE;		// it is being referenced
+    kernel->machine->tlb->Load(&pageTable[vpn]);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::MarkDirty
+//  Handle the first write to a page that was clean when its entry
+//  was loaded into the TLB: mark it dirty in the page table, and load
+//  the entry again, now allowing writes.  Return FALSE if the page
+//  really is read-only.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::MarkDirty(int vaddr)
+{
+    unsigned int vpn = (unsigned) vaddr / PageSize;
+
+    if (vpn >= mapEnd || !pageTable[vpn].valid || pageTable[vpn].readOnly)
+	return FALSE;
+    pageTable[vpn].dirty = TRUE;
+    kernel->machine->tlb->Load(&pageTable[vpn]);
+    return TRUE;
+}
@@ -0,0 +1,100 @@
+// addrspace.h 
+//	Data structures to keep track of executing user programs 
+//	(address spaces).
+//
+//	For now, we don't keep any information about address spaces.
+//	The user level CPU state is saved and restored in the thread
+//	executing the user program (see thread.h).
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef ADDRSPACE_H
+#define ADDRSPACE_H
+
+#include "copyright.h"
+#include "filesys.h"
+
+#define UserStackSize		1024 	// increase this as necessary!
+#define MaxMappings		8	// regions a program can have mapped
+
+// A range of a file mapped into the address space by Mmap.  Its pages
+// start out invalid, are read from the file on the first access, and
+// the ones written are copied back to the file when it is unmapped.
+class Mapping {
+  public:
+    OpenFile *file;			// our own open of the mapped file
+    int offset;				// byte of the file at firstPage
+    int length;				// bytes mapped
+    int firstPage;			// first virtual page of the region
+    int numPages;			// pages in the region
+};
+
+class AddrSpace {
+  public:
+    AddrSpace();			// Create an address space.
+    ~AddrSpace();			// De-allocate an address space
+
+    bool Load(char *fileName);		// Load a program into addr space from
+                                        // a file
+					// return false if not found, or
+					// too big for memory
+
+    void Execute(char *fileName);             	// Run a program
+					// assumes the program has already
+                                        // been loaded
+
+    void SaveState();			// Save/restore address space-specific
+    void RestoreState();		// info on a context switch 
+
+    bool HasMappings();			// Is any file mapped into it?
+    void Save(int fd);			// Write the page table into a
+    void Restore(int fd);		// checkpoint, or read it back
+
+    // Translate virtual address _vaddr_
+    // to physical address _paddr_. _mode_
+    // is 0 for Read, 1 for Write.
+    ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
+
+    int Map(OpenFile *file, int offset, int length);
+					// Map part of a file after the end
+					// of the address space; return its
+					// virtual address, or -1
+    bool Unmap(int addr);		// Write back and unmap the region
+					// mapped at "addr"
+    void UnmapAll();			// Unmap everything, at exit
+    bool PageFault(int vaddr);		// Read in the mapped page holding
+					// "vaddr"; FALSE if it isn't mapped
+    bool FaultIn(int addr, int size, bool toUser);
+					// Read in the mapped pages of a
+					// syscall buffer; FALSE if it isn't
+					// all there, or can't be written
+    bool LoadTLB(int vaddr);		// Load the translation of "vaddr"
+					// into the TLB; FALSE if the page
+					// isn't valid
+    bool MarkDirty(int vaddr);		// First write to the page holding
+					// "vaddr": mark it dirty, and load
+					// it again; FALSE if read-only
+
+  private:
+    TranslationEntry *pageTable;	// Assume linear page table translation
+					// for now!
+    unsigned int numPages;		// Number of pages in the virtual 
+					// address space
+    unsigned int mapEnd;		// First page past the mapped regions,
+					// which follow the stack
+    Mapping *mappings[MaxMappings];	// Mapped regions, NULL if unused
+    int asid;				// Tags our entries in the TLB
+
+    bool WriteBack(Mapping *map);	// Copy its dirty pages to the file;
+					// FALSE if one didn't fit
+    void TranslationsChanged();		// Forget the translations the
+					// machine copied from pageTable
+
+    void InitRegisters();		// Initialize user-level CPU registers,
+					// before jumping to user code
+
+};
+
+#endif // ADDRSPACE_H
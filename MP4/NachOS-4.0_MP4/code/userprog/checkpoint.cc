@@ -0,0 +1,325 @@
+// checkpoint.cc
+//	Routines to checkpoint the machine, and to boot it from a
+//	checkpoint (see checkpoint.h).
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "checkpoint.h"
+#include "main.h"
+#include "sysdep.h"
+#include "addrspace.h"
+#include "synchdisk.h"
+#include <string.h>
+
+//----------------------------------------------------------------------
+// Checkpoint::Checkpoint
+// 	Get ready to checkpoint the machine every "interval" ticks, into
+//	host file "fileName".
+//----------------------------------------------------------------------
+
+Checkpoint::Checkpoint(int interval, char *fileName)
+{
+    ASSERT(interval > 0);
+    this->interval = interval;
+    this->fileName = fileName;
+    nextCheckpoint = interval;
+    numTaken = 0;
+    lastTaken = 0;
+}
+
+//----------------------------------------------------------------------
+// Checkpoint::~Checkpoint
+// 	Say how many checkpoints were taken, and when the last one was.
+//----------------------------------------------------------------------
+
+Checkpoint::~Checkpoint()
+{
+    if (numTaken == 0)
+	cout << "Checkpoint: none taken\n";
+    else
+	cout << "Checkpoint: " << numTaken << " taken, the last at tick "
+		<< lastTaken << ", in " << fileName << "\n";
+}
+
+//----------------------------------------------------------------------
+// Checkpoint::Take
+// 	A checkpoint is due: write one, if the machine can be saved now,
+//	and schedule the next; or else try again soon.
+//----------------------------------------------------------------------
+
+void
+Checkpoint::Take()
+{
+    Thread *thread = kernel->currentThread;
+    List<Thread *> *ready = kernel->scheduler->getReadyList();
+    int now = kernel->stats->totalTicks;
+    int header[3] = { CheckpointMagic, PageSize, MemorySize };
+    int numThreads = 1 + ready->NumInList();
+    int fd;
+
+    if (!Ready()) {
+	nextCheckpoint = now + CheckpointRetry;
+	return;
+    }
+    DEBUG(dbgThread, "Checkpoint at tick " << now << ", of " << numThreads
+		<< " threads");
+    thread->SaveUserState();		// the others' were, when they
+					// were preempted
+    fd = OpenForWrite(fileName);
+    WriteFile(fd, (char *) header, sizeof(header));
+#ifndef FILESYS_STUB
+    kernel->fileSystem->Save(fd);
+    kernel->synchDisk->SaveHead(fd);
+#endif
+    WriteFile(fd, (char *) &kernel->threadNum, sizeof(int));
+    WriteFile(fd, (char *) &kernel->ending, sizeof(bool));
+    WriteFile(fd, (char *) &numThreads, sizeof(int));
+    SaveThread(fd, thread);
+    for (ListIterator<Thread *> iter(ready); !iter.IsDone(); iter.Next())
+	SaveThread(fd, iter.Item());
+    WriteFile(fd, kernel->machine->mainMemory, MemorySize);
+    WriteFile(fd, (char *) kernel->stats, sizeof(Statistics));
+    kernel->interrupt->Save(fd);
+    Close(fd);
+
+    numTaken++;
+    lastTaken = now;
+    Restart();
+}
+
+//----------------------------------------------------------------------
+// Checkpoint::Restart
+// 	Make the next checkpoint due at the first multiple of the interval
+//	after now: the last one was just taken, or the time was just set
+//	to a checkpoint's.
+//----------------------------------------------------------------------
+
+void
+Checkpoint::Restart()
+{
+    nextCheckpoint = (kernel->stats->totalTicks / interval + 1) * interval;
+}
+
+//----------------------------------------------------------------------
+// Checkpoint::Ready
+// 	Return TRUE if the machine can be saved now (see checkpoint.h): no
+//	device is busy, the running thread and the ready ones are all the
+//	threads there are, and each of the ready ones was preempted in user
+//	code.
+//----------------------------------------------------------------------
+
+bool
+Checkpoint::Ready()
+{
+    List<Thread *> *ready = kernel->scheduler->getReadyList();
+
+    if (kernel->interrupt->getStatus() != UserMode
+		|| !kernel->interrupt->Quiet())
+	return FALSE;
+    if (kernel->numThreads != 1 + (int) ready->NumInList())
+	return FALSE;			// some are waiting
+    if (!Resumable(kernel->currentThread))
+	return FALSE;
+    for (ListIterator<Thread *> iter(ready); !iter.IsDone(); iter.Next()) {
+	if (!iter.Item()->preempted || !Resumable(iter.Item()))
+	    return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Checkpoint::Resumable
+// 	Return TRUE if "thread" runs a user program that has no file open
+//	(but the console) or mapped: a new thread can take its place with
+//	just its registers and page table.
+//----------------------------------------------------------------------
+
+bool
+Checkpoint::Resumable(Thread *thread)
+{
+    return thread->space != NULL && !thread->space->HasMappings()
+		&& thread->openFiles->IsEmpty();
+}
+
+//----------------------------------------------------------------------
+// Checkpoint::SaveThread
+// 	Write the name and ID of "thread", its registers as last saved,
+//	and its page table, into the checkpoint open as host file "fd".
+//----------------------------------------------------------------------
+
+void
+Checkpoint::SaveThread(int fd, Thread *thread)
+{
+    int length = strlen(thread->getName()) + 1;
+    int id = thread->getID();
+
+    WriteFile(fd, (char *) &length, sizeof(int));
+    WriteFile(fd, thread->getName(), length);
+    WriteFile(fd, (char *) &id, sizeof(int));
+    thread->Save(fd);
+    thread->space->Save(fd);
+}
+
+//----------------------------------------------------------------------
+// ResumeThread
+// 	The procedure each thread made from a checkpoint starts with.
+//----------------------------------------------------------------------
+
+static void
+ResumeThread(Restorer *restorer)
+{
+    restorer->Resume();
+}
+
+//----------------------------------------------------------------------
+// Restorer::Restorer
+// 	Open checkpoint "fileName", and set "pageSize" and "memorySize"
+//	to those of the machine that wrote it, before the kernel makes
+//	one.
+//----------------------------------------------------------------------
+
+Restorer::Restorer(char *fileName, int *pageSize, int *memorySize)
+{
+    int header[3];
+
+    fd = OpenForReadWrite(fileName, TRUE);
+    Read(fd, (char *) header, sizeof(header));
+    ASSERT(header[0] == CheckpointMagic);
+    *pageSize = header[1];
+    *memorySize = header[2];
+    numThreads = 0;
+    threads = NULL;
+    spaces = NULL;
+    names = NULL;
+    started = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Restorer::~Restorer
+// 	Deallocate the names of the threads made; they may still have
+//	been in use until now.
+//----------------------------------------------------------------------
+
+Restorer::~Restorer()
+{
+    for (int i = 0; i < numThreads; i++)
+	delete [] names[i];
+    delete [] names;
+    delete [] threads;
+    delete [] spaces;
+}
+
+//----------------------------------------------------------------------
+// Restorer::RestoreDisk
+// 	Write the sectors of the checkpoint to disk, before the file
+//	system is mounted.
+//----------------------------------------------------------------------
+
+void
+Restorer::RestoreDisk()
+{
+#ifndef FILESYS_STUB
+    kernel->synchDisk->Restore(fd);
+#endif
+}
+
+//----------------------------------------------------------------------
+// Restorer::RestoreFileSystem
+// 	Once the file system is mounted, read back the rest of its state,
+//	and where the disk head was.
+//----------------------------------------------------------------------
+
+void
+Restorer::RestoreFileSystem()
+{
+#ifndef FILESYS_STUB
+    kernel->fileSystem->Restore(fd);
+    kernel->synchDisk->RestoreHead(fd);
+#endif
+}
+
+//----------------------------------------------------------------------
+// Restorer::RestoreThreads
+// 	Make a thread for each one in the checkpoint, with its registers
+//	and address space, and put them on the ready list in order, the
+//	one that was running first.  Then read back main memory, and set
+//	the time and the pending interrupts to the checkpoint's.
+//
+//	Interrupts are left off: the caller (the main thread) finishes,
+//	and the first thread resumes its program once Thread::Begin has
+//	turned them on, which takes a tick of its own.  So that nothing
+//	comes due meanwhile, the clock is set that much earlier; Resume
+//	then puts the statistics back as they were.
+//----------------------------------------------------------------------
+
+void
+Restorer::RestoreThreads()
+{
+    bool ending;
+    int length, id;
+
+    (void) kernel->interrupt->SetLevel(IntOff);
+    Read(fd, (char *) &kernel->threadNum, sizeof(int));
+    Read(fd, (char *) &ending, sizeof(bool));
+    Read(fd, (char *) &numThreads, sizeof(int));
+    threads = new Thread *[numThreads];
+    spaces = new AddrSpace *[numThreads];
+    names = new char *[numThreads];
+    for (int i = 0; i < numThreads; i++) {
+	Read(fd, (char *) &length, sizeof(int));
+	names[i] = new char[length];
+	Read(fd, names[i], length);
+	Read(fd, (char *) &id, sizeof(int));
+	threads[i] = new Thread(names[i], id);
+	threads[i]->Restore(fd);
+	spaces[i] = new AddrSpace();	// clears main memory, so before
+	spaces[i]->Restore(fd);		// it is read
+	kernel->t[id] = threads[i];
+    }
+    Read(fd, kernel->machine->mainMemory, MemorySize);
+    Read(fd, (char *) &stats, sizeof(Statistics));
+    kernel->interrupt->Restore(fd);
+    Close(fd);
+    if (ending)
+	kernel->PrepareToEnd();
+
+    // Each thread only gets its address space as it resumes: until
+    // then, a context switch must not save the machine's registers
+    // over the ones just read.
+
+    for (int i = 0; i < numThreads; i++)
+	threads[i]->Fork((VoidFunctionPtr) ResumeThread, (void *) this);
+    *kernel->stats = stats;
+    kernel->stats->totalTicks -= SystemTick;
+}
+
+//----------------------------------------------------------------------
+// Restorer::Resume
+// 	Run the program of the thread just started, from where it was at
+//	the checkpoint.  The first thread to run first puts the statistics
+//	back, now that no more time is to pass before it does.
+//----------------------------------------------------------------------
+
+void
+Restorer::Resume()
+{
+    Thread *thread = kernel->currentThread;
+    int i;
+
+    if (!started) {
+	*kernel->stats = stats;
+	if (kernel->checkpoint != NULL)
+	    kernel->checkpoint->Restart();
+	started = TRUE;
+    }
+    for (i = 0; threads[i] != thread; i++)
+	;
+    thread->space = spaces[i];
+    thread->RestoreUserState();
+    thread->space->RestoreState();
+    kernel->machine->Run();		// never returns
+    ASSERTNOTREACHED();
+}
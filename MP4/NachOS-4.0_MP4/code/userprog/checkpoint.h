@@ -0,0 +1,118 @@
+// checkpoint.h
+//	Data structures for saving the state of the simulated machine to a
+//	host file every so often, and for booting from such a checkpoint,
+//	so that a long run can be resumed where it was instead of started
+//	over (or a warmup run once, and skipped from then on).
+//
+//	The host threads the kernel runs on can't be saved, so we can only
+//	take a checkpoint when no thread is in the middle of the kernel:
+//	one is running user code, and every other one was preempted by the
+//	timer while running user code, and is ready to run.  No device but
+//	the timer and the console input may be busy, and no program may
+//	have files open or mapped.  Then each thread is just its user
+//	registers and its page table; the rest is main memory, the disk
+//	(as the file system sees it, with its log), the statistics, and
+//	what interrupts are pending.  If a checkpoint falls due when that
+//	isn't the case, we try again CheckpointRetry ticks later.
+//
+//	Like profile samples, checkpoints are taken between two user
+//	instructions, when simulated time reaches NextCheckpoint (see
+//	Machine::NextStop).  Each one overwrites the last, in this order:
+//
+//		magic number, page size, memory size
+//		each sector of the disk, then the file system's state
+//		the disk head
+//		the kernel's thread count, then each thread (the running
+//		one first, then the ready list in order): its name, ID,
+//		registers and page table
+//		main memory
+//		the statistics, and the pending interrupts
+//
+//	"nachos -restore" boots a machine with the checkpoint's page and
+//	memory sizes, puts the disk back before mounting it, and then makes
+//	new threads that pick each program up where it was, instead of
+//	running any.  From there the run is the one that was checkpointed:
+//	same output, and the same statistics when it halts.
+//
+//	A checkpoint is written as the structures lie in memory, so it is
+//	only good for the Nachos binary that wrote it.  It needs one
+//	processor, and no TLB or random time slices.  The console input,
+//	the profile, and the I/O counts of each file (-stats) start over.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "stats.h"
+
+class Thread;
+class AddrSpace;
+
+#define CheckpointMagic	0x4e43504b	// "NCPK": a Nachos checkpoint
+#define CheckpointRetry	100		// ticks before trying again, when
+					// one can't be taken yet
+
+// Takes the checkpoints.
+
+class Checkpoint {
+  public:
+    Checkpoint(int interval, char *fileName);
+					// Checkpoint every "interval" ticks,
+					// into host file "fileName"
+    ~Checkpoint();			// Say how many were taken
+
+    int NextCheckpoint() { return nextCheckpoint; }
+					// When the next one is due
+    void Take();			// Take it, if the machine can be
+					// saved now
+    void Restart();			// Time was set back or forward to a
+					// checkpoint's; skip to the next
+					// multiple of the interval
+
+  private:
+    bool Ready();			// Can the machine be saved now?
+    bool Resumable(Thread *thread);	// Is "thread" just its registers
+					// and page table?
+    void SaveThread(int fd, Thread *thread);
+
+    int interval;
+    char *fileName;
+    int nextCheckpoint;			// tick the next one is due
+    int numTaken;			// so far
+    int lastTaken;			// tick of the last one
+};
+
+// Boots the machine from a checkpoint.  The kernel calls each step in
+// turn, as it initializes and then instead of running the programs.
+
+class Restorer {
+  public:
+    Restorer(char *fileName, int *pageSize, int *memorySize);
+					// Open checkpoint "fileName", and
+					// set the sizes the machine had
+    ~Restorer();
+
+    void RestoreDisk();			// Put the sectors back, before the
+					// file system is mounted
+    void RestoreFileSystem();		// The rest of it, once it is
+    void RestoreThreads();		// Make the threads, and set the
+					// time back
+    void Resume();			// Called by each thread made, as it
+					// starts: run its program
+
+  private:
+    int fd;				// the checkpoint, while it is read
+    int numThreads;
+    Thread **threads;			// the threads made
+    AddrSpace **spaces;			// their address spaces
+    char **names;			// and names
+    Statistics stats;			// as they were at the checkpoint
+    bool started;			// has the first thread resumed?
+};
+
+#endif // CHECKPOINT_H
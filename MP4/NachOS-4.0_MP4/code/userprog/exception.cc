@@ -120,9 +120,7 @@ ExceptionHandler(ExceptionType which)
 		case SC_Write:
 			val = kernel->machine->ReadRegister(4);
 			{
-			char *buffer = &(kernel->machine->mainMemory[val]); // find file content
-			//cout << filename << endl;
-			status = SysWrite(buffer, (int)kernel->machine->ReadRegister(5), (int)kernel->machine->ReadRegister(6));
+			status = SysWrite(val, (int)kernel->machine->ReadRegister(5), (int)kernel->machine->ReadRegister(6));
 			// (buffer, size, id). states = numBytes actually written
 			kernel->machine->WriteRegister(2, (int) status);
 			}
@@ -136,9 +134,7 @@ ExceptionHandler(ExceptionType which)
 		case SC_Read:
 			val = kernel->machine->ReadRegister(4);
 			{
-			char *buffer = &(kernel->machine->mainMemory[val]);
-			//cout << filename << endl;
-			status = SysRead(buffer, (int)kernel->machine->ReadRegister(5), (int)kernel->machine->ReadRegister(6));
+			status = SysRead(val, (int)kernel->machine->ReadRegister(5), (int)kernel->machine->ReadRegister(6));
 			// (buffer, size, id). states = numBytes actually read
 			kernel->machine->WriteRegister(2, (int) status);
 			}
@@ -149,6 +145,114 @@ ExceptionHandler(ExceptionType which)
 			ASSERTNOTREACHED();
 			break;
 
+		case SC_Seek:
+			status = SysSeek((int)kernel->machine->ReadRegister(4), (int)kernel->machine->ReadRegister(5));
+			// (position, id)
+			kernel->machine->WriteRegister(2, (int) status);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+
+		case SC_PRead:
+		case SC_PWrite:
+			val = kernel->machine->ReadRegister(4);
+			{
+			int size = (int)kernel->machine->ReadRegister(5);
+			int position = (int)kernel->machine->ReadRegister(6);
+			int id = (int)kernel->machine->ReadRegister(7);
+			// (buffer, size, position, id). status = numBytes actually read/written
+			if (type == SC_PRead)
+				status = SysPRead(val, size, position, id);
+			else
+				status = SysPWrite(val, size, position, id);
+			kernel->machine->WriteRegister(2, (int) status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+
+		case SC_ReadV:
+		case SC_WriteV:
+			val = kernel->machine->ReadRegister(4);
+			// (vec, count, id). status = total numBytes actually read/written
+			status = SysTransferV(val, (int)kernel->machine->ReadRegister(5), 
+					(int)kernel->machine->ReadRegister(6), type == SC_WriteV);
+			kernel->machine->WriteRegister(2, (int) status);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+
+		case SC_Mmap:
+			status = SysMmap((int)kernel->machine->ReadRegister(4), 
+					(int)kernel->machine->ReadRegister(5), (int)kernel->machine->ReadRegister(6));
+			// (id, offset, length). status = address of the mapping
+			kernel->machine->WriteRegister(2, (int) status);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+
+		case SC_Munmap:
+			status = SysMunmap((int)kernel->machine->ReadRegister(4));
+			kernel->machine->WriteRegister(2, (int) status);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Remove:
+			val = kernel->machine->ReadRegister(4);
+			{
+			char *filename = &(kernel->machine->mainMemory[val]);
+			status = SysRemove(filename);
+			kernel->machine->WriteRegister(2, (int) status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		case SC_Rename:
+		case SC_Link:
+			{
+			char *from = &(kernel->machine->mainMemory[kernel->machine->ReadRegister(4)]);
+			char *to = &(kernel->machine->mainMemory[kernel->machine->ReadRegister(5)]);
+			status = (type == SC_Rename) ? SysRename(from, to) : SysLink(from, to);
+			kernel->machine->WriteRegister(2, (int) status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+
+		case SC_Stat:
+			{
+			char *name = &(kernel->machine->mainMemory[kernel->machine->ReadRegister(4)]);
+			status = SysStat(name, kernel->machine->ReadRegister(5));
+			kernel->machine->WriteRegister(2, (int) status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg)+4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+
 		/*====================================MP4==============================================*/
 		#ifdef FILESYS_STUB
 		case SC_Create:
@@ -194,6 +298,7 @@ ExceptionHandler(ExceptionType which)
 			DEBUG(dbgAddr, "Program exit\n");
             val=kernel->machine->ReadRegister(4);
             cout << "return value:" << val << endl;
+			kernel->currentThread->space->UnmapAll();	// write back mapped files
 			kernel->currentThread->Finish();
             break;
       	default:
@@ -201,6 +306,25 @@ ExceptionHandler(ExceptionType which)
 			break;
 		}
 		break;
+	case PageFaultException:
+		// a TLB miss, or a mapped file page not read in yet; return
+		// without moving the PC, so the instruction is retried
+		val = kernel->machine->ReadRegister(BadVAddrReg);
+		if (kernel->machine->tlb != NULL &&
+				kernel->currentThread->space->LoadTLB(val))
+			return;
+		if (kernel->currentThread->space->PageFault(val))
+			return;
+		cerr << "Unexpected page fault at " << val << "\n";
+		break;
+	case ReadOnlyException:
+		// with a TLB, the first write to a page that was clean
+		val = kernel->machine->ReadRegister(BadVAddrReg);
+		if (kernel->machine->tlb != NULL &&
+				kernel->currentThread->space->MarkDirty(val))
+			return;
+		cerr << "Write to read-only page at " << val << "\n";
+		break;
 	default:
 		cerr << "Unexpected user mode exception " << (int)which << "\n";
 		break;
@@ -0,0 +1,102 @@
+// fdtable.cc 
+//	Routines to hand out, look up and close a thread's open file
+//	descriptors.  See fdtable.h.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "fdtable.h"
+#include "syscall.h"
+
+// first id that can name a file; the ones below it are the console
+static const int FirstFileId = SysConsoleOutput + 1;
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::FileDescriptorTable
+// 	Initialize a table with no open files.
+//----------------------------------------------------------------------
+
+FileDescriptorTable::FileDescriptorTable()
+{
+    for (int i = 0; i < MaxOpenFiles; i++)
+	table[i] = NULL;
+    hint = FirstFileId;
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::~FileDescriptorTable
+// 	Close whatever the thread left open.
+//----------------------------------------------------------------------
+
+FileDescriptorTable::~FileDescriptorTable()
+{
+    for (int i = FirstFileId; i < MaxOpenFiles; i++)
+	delete table[i];
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::Add
+// 	Give "file" the lowest free id, and return it.  Return -1 if the
+//	thread already has MaxOpenFiles files open.
+//----------------------------------------------------------------------
+
+int
+FileDescriptorTable::Add(OpenFile *file)
+{
+    for (int i = hint; i < MaxOpenFiles; i++)
+	if (table[i] == NULL) {
+	    table[i] = file;
+	    hint = i + 1;
+	    return i;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::Get
+// 	Return the file open as "id", or NULL if "id" isn't open.
+//----------------------------------------------------------------------
+
+OpenFile *
+FileDescriptorTable::Get(int id)
+{
+    if (id < FirstFileId || id >= MaxOpenFiles)
+	return NULL;
+    return table[id];
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::Remove
+// 	Close the file open as "id", and free the id.  Return FALSE if
+//	"id" isn't open.
+//----------------------------------------------------------------------
+
+bool
+FileDescriptorTable::Remove(int id)
+{
+    OpenFile *file = Get(id);
+
+    if (file == NULL)
+	return FALSE;
+    delete file;
+    table[id] = NULL;
+    if (id < hint)
+	hint = id;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileDescriptorTable::IsEmpty
+// 	Return TRUE if no file is open, besides the console.
+//----------------------------------------------------------------------
+
+bool
+FileDescriptorTable::IsEmpty()
+{
+    for (int id = FirstFileId; id < MaxOpenFiles; id++)
+	if (table[id] != NULL)
+	    return FALSE;
+    return TRUE;
+}
@@ -0,0 +1,41 @@
+// fdtable.h 
+//	Data structures for a thread's table of open file descriptors.
+//
+//	A user program names the files it has open by OpenFileId, a 
+//	small integer handed out by the Open system call.  Each thread
+//	has its own table, so ids in different programs are unrelated,
+//	and the table is indexed directly by id.  Ids 0 and 1 are the
+//	console (SysConsoleInput, SysConsoleOutput) and are never
+//	handed out.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FDTABLE_H
+#define FDTABLE_H
+
+#include "copyright.h"
+#include "utility.h"
+#include "openfile.h"
+
+#define MaxOpenFiles	20	// open files per thread, counting the 
+				// two console ids
+
+class FileDescriptorTable {
+  public:
+    FileDescriptorTable();		// Initialize an empty table
+    ~FileDescriptorTable();		// Close every file still open
+
+    int Add(OpenFile *file);		// Return a free id for "file",
+					// or -1 if the table is full
+    OpenFile *Get(int id);		// The file open as "id", or NULL
+    bool Remove(int id);		// Close "id"; FALSE if it isn't open
+    bool IsEmpty();			// No file is open
+
+  private:
+    OpenFile *table[MaxOpenFiles];	// table[id] is the file open as id
+    int hint;				// no free id below this one
+};
+
+#endif // FDTABLE_H
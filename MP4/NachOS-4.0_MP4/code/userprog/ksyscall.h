@@ -18,6 +18,8 @@
 
 void SysHalt()
 {
+  if (kernel->currentThread->space != NULL)
+    kernel->currentThread->space->UnmapAll();	// write back mapped files
   kernel->interrupt->Halt();
 }
 
@@ -27,6 +29,20 @@ int SysAdd(int op1, int op2)
 }
 
 /*===================MP4=======================*/
+// does the user range [addr, addr + size) lie inside main memory?
+bool InMemory(int addr, int size)
+{
+	return addr >= 0 && size >= 0 && addr <= MemorySize - size;
+}
+
+// can the kernel copy "size" bytes to ("toUser") or from the user
+// buffer at "addr"?  Reads in the mapped pages of it first
+bool UserBuffer(int addr, int size, bool toUser)
+{
+	return InMemory(addr, size) && 
+		kernel->currentThread->space->FaultIn(addr, size, toUser);
+}
+
 int SysCreate(char *name, int size)
 {
 
@@ -35,35 +51,171 @@ int SysCreate(char *name, int size)
 
 OpenFileId SysOpen(char *filename)
 {
-  // return fileDescriptorTable entry (1~20)
+  // return the id in this thread's descriptor table (2~19)
   // -1 : failed
 	OpenFile* file_pointer = kernel->fileSystem->Open(filename);
 	if (file_pointer == NULL) return -1;
-	else return 1;
+	OpenFileId id = kernel->currentThread->openFiles->Add(file_pointer);
+	if (id < 0) delete file_pointer;	// too many files open
+	return id;
 }
 
 int SysClose(int id)
 {
 	// return value
 	// 1: success
-	// 0: failed
-	return kernel->fileSystem->CloseFile(id);
+	// -1: failed
+	return kernel->currentThread->openFiles->Remove(id) ? 1 : -1;
 }
 
-int SysWrite(char *buffer, int size, int id)
+// "buffer" is the user address of "size" bytes
+int SysWrite(int buffer, int size, int id)
 {
 	// return value
 	// -1: failed
   // else: numBytes actually written
-	return kernel->fileSystem->WriteFile(buffer, size, id);
+	OpenFile* file_pointer = kernel->currentThread->openFiles->Get(id);
+	if (file_pointer == NULL || !UserBuffer(buffer, size, FALSE)) return -1;
+	return file_pointer->Write(&(kernel->machine->mainMemory[buffer]), size);
 }
 
-int SysRead(char *buffer, int size, int id)
+// "buffer" is the user address of "size" bytes
+int SysRead(int buffer, int size, int id)
 {
 	// return value
 	// -1: failed
   // else: numBytes actually read
-	return kernel->fileSystem->ReadFile(buffer, size, id);
+	OpenFile* file_pointer = kernel->currentThread->openFiles->Get(id);
+	if (file_pointer == NULL || !UserBuffer(buffer, size, TRUE)) return -1;
+	return file_pointer->Read(&(kernel->machine->mainMemory[buffer]), size);
+}
+
+int SysSeek(int position, int id)
+{
+	// return value
+	// 1: success
+	// -1: failed
+	OpenFile* file_pointer = kernel->currentThread->openFiles->Get(id);
+	if (file_pointer == NULL || position < 0) return -1;
+	file_pointer->Seek(position);
+	return 1;
+}
+
+// "buffer" is the user address of "size" bytes
+int SysPRead(int buffer, int size, int position, int id)
+{
+	// return value
+	// -1: failed
+  // else: numBytes actually read; the seek position doesn't move
+	OpenFile* file_pointer = kernel->currentThread->openFiles->Get(id);
+	if (file_pointer == NULL || position < 0 || 
+			!UserBuffer(buffer, size, TRUE)) 
+		return -1;
+	return file_pointer->ReadAt(&(kernel->machine->mainMemory[buffer]), 
+				size, position);
+}
+
+// "buffer" is the user address of "size" bytes
+int SysPWrite(int buffer, int size, int position, int id)
+{
+	// return value
+	// -1: failed
+  // else: numBytes actually written; the seek position doesn't move
+	OpenFile* file_pointer = kernel->currentThread->openFiles->Get(id);
+	if (file_pointer == NULL || position < 0 || 
+			!UserBuffer(buffer, size, FALSE)) 
+		return -1;
+	return file_pointer->WriteAt(&(kernel->machine->mainMemory[buffer]), 
+				size, position);
+}
+
+// "vec" is the user address of "count" IoVecs, each two words: the
+// user address of a buffer, and its length
+int SysTransferV(int vec, int count, int id, bool writing)
+{
+	// return value
+	// -1: failed
+  // else: total numBytes actually read/written
+	OpenFile* file_pointer = kernel->currentThread->openFiles->Get(id);
+	int total = 0;
+	if (file_pointer == NULL || count < 0 || count > IoVecMax 
+			|| !UserBuffer(vec, 8 * count, FALSE)) 
+		return -1;
+	for (int i = 0; i < count; i++) {
+		int *entry = (int *) &(kernel->machine->mainMemory[vec + 8 * i]);
+		int addr = WordToHost(entry[0]);
+		int len = WordToHost(entry[1]);
+		char *base;
+		int done;
+		if (!UserBuffer(addr, len, !writing)) return -1;
+		base = &(kernel->machine->mainMemory[addr]);
+		done = writing ? file_pointer->Write(base, len) 
+				: file_pointer->Read(base, len);
+		total += done;
+		if (done < len) break;		// end of file
+	}
+	return total;
+}
+
+int SysRemove(char *name)
+{
+	// return value
+	// 1: success
+	// -1: failed
+	return kernel->fileSystem->Remove(name) ? 1 : -1;
+}
+
+int SysRename(char *from, char *to)
+{
+	// return value
+	// 1: success
+	// -1: failed
+	return kernel->fileSystem->Rename(from, to) ? 1 : -1;
+}
+
+int SysLink(char *from, char *to)
+{
+	// return value
+	// 1: success
+	// -1: failed
+	return kernel->fileSystem->Link(from, to) ? 1 : -1;
+}
+
+// "st" is the user address of a FileStat: five words
+int SysStat(char *name, int st)
+{
+	// return value
+	// 1: success
+	// -1: failed
+	FileInfo info;
+	int *words;
+	if (!UserBuffer(st, 5 * 4, TRUE) || !kernel->fileSystem->Stat(name, &info))
+		return -1;
+	words = (int *) &(kernel->machine->mainMemory[st]);
+	words[0] = WordToMachine(info.size);
+	words[1] = WordToMachine(info.isDir ? 1 : 0);
+	words[2] = WordToMachine(info.links);
+	words[3] = WordToMachine(info.createTime);
+	words[4] = WordToMachine(info.modifyTime);
+	return 1;
+}
+
+int SysMmap(int id, int offset, int length)
+{
+	// return value
+	// -1: failed
+  // else: user address of the mapping
+	OpenFile* file_pointer = kernel->currentThread->openFiles->Get(id);
+	if (file_pointer == NULL) return -1;
+	return kernel->currentThread->space->Map(file_pointer, offset, length);
+}
+
+int SysMunmap(int addr)
+{
+	// return value
+	// 1: success
+	// -1: failed
+	return kernel->currentThread->space->Unmap(addr) ? 1 : -1;
 }
 
 /*===================MP4=======================*/
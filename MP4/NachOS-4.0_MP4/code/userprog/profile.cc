@@ -0,0 +1,216 @@
+// profile.cc
+//	Routines of the sampling profiler of user programs (see profile.h).
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "profile.h"
+#include "main.h"
+#include "sysdep.h"
+#include "addrspace.h"
+#include <string.h>
+#include <stdio.h>
+
+// The instructions the stack walk looks for, as gcc generates them.
+
+#define JumpRA		0x03e00008	// jr ra: a function ends
+#define AddiuSP		0x27bd0000	// addiu sp,sp,imm: "imm" < 0 makes
+					// a frame
+#define SaveRA		0xafbf0000	// sw ra,imm(sp)
+
+//----------------------------------------------------------------------
+// Profiler::Profiler
+// 	Get ready to take a sample every "interval" ticks.  The profile
+//	is kept in memory until Nachos halts, then written to "fileName".
+//----------------------------------------------------------------------
+
+Profiler::Profiler(int interval, char *fileName)
+{
+    ASSERT(interval > 0);
+    this->interval = interval;
+    this->fileName = fileName;
+    nextSample = interval;
+    numSamples = 0;
+    for (int i = 0; i < ProfileBuckets; i++)
+	buckets[i] = NULL;
+}
+
+//----------------------------------------------------------------------
+// Profiler::~Profiler
+// 	Write the profile out, one line per distinct stack, after a first
+//	line giving the sampling interval; and deallocate it.
+//----------------------------------------------------------------------
+
+Profiler::~Profiler()
+{
+    char line[32 + 9 * MaxProfileDepth];
+    int fd = OpenForWrite(fileName);
+    ProfileStack *stack, *next;
+
+    sprintf(line, "# nachos profile, one sample every %d ticks\n", interval);
+    WriteFile(fd, line, strlen(line));
+    for (int i = 0; i < ProfileBuckets; i++) {
+	for (stack = buckets[i]; stack != NULL; stack = next) {
+	    next = stack->next;
+	    sprintf(line, "%d %d ", stack->count, stack->threadID);
+	    WriteFile(fd, line, strlen(line));
+	    WriteFile(fd, stack->threadName, strlen(stack->threadName));
+	    line[0] = '\0';
+	    for (int j = 0; j < stack->depth; j++)
+		sprintf(line + strlen(line), " %x", stack->pcs[j]);
+	    strcat(line, "\n");
+	    WriteFile(fd, line, strlen(line));
+	    delete [] stack->threadName;
+	    delete stack;
+	}
+    }
+    Close(fd);
+    cout << "Profile: " << numSamples << " samples, written to "
+		<< fileName << "\n";
+}
+
+//----------------------------------------------------------------------
+// Profiler::Sample
+// 	Count the stack of the user program on the CPU, and schedule the
+//	next sample.  Samples that fell due while no user program ran are
+//	dropped.
+//----------------------------------------------------------------------
+
+void
+Profiler::Sample()
+{
+    int pcs[MaxProfileDepth];
+    int depth = Unwind(pcs);
+    Thread *thread = kernel->currentThread;
+
+    Find(thread->getID(), depth, pcs)->count++;
+    numSamples++;
+    while (nextSample <= kernel->stats->totalTicks)
+	nextSample += interval;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Unwind
+// 	Find the call stack of the running program: its PC, then the
+//	address of each call that is still active, up to MaxProfileDepth.
+//	Return how many were found.
+//
+//	For each function, we look back from where it is (the PC, or just
+//	before the call to the function it called) for the instruction
+//	that made its frame, and from there forward for the one that
+//	saved its return address, so we know where to find it.  Reaching
+//	a "jr ra" first means we are in a function with no frame, or in
+//	its return, with the frame already gone; only for the innermost
+//	function is the return address then still in r31 (unless the
+//	function itself made a call, which changed it).
+//
+//	The call was the instruction before the delay slot the return
+//	address points past.
+//----------------------------------------------------------------------
+
+int
+Profiler::Unwind(int *pcs)
+{
+    Machine *machine = kernel->machine;
+    int pc = machine->ReadRegister(PCReg);
+    int sp = machine->ReadRegister(StackReg);
+    int ra = machine->ReadRegister(RetAddrReg);
+    int depth, addr, low, word, start, frame, save;
+
+    for (depth = 0; depth < MaxProfileDepth; ) {
+	pcs[depth++] = pc;
+
+	start = -1;			// the function's "addiu sp"
+	for (low = pc; low >= 0 && pc - low < MaxFrameScan * 4; low -= 4) {
+	    if (!ReadWord(low, &word) || (unsigned) word == JumpRA)
+		break;
+	    if ((word & 0xffff8000) == (AddiuSP | 0x8000)) {
+		start = low;
+		break;
+	    }
+	}
+	save = -1;			// where it saved ra
+	frame = 0;			// its size, once it is made
+	if (start >= 0 && start < pc) {
+	    frame = -(short) (word & 0xffff);
+	    for (addr = start + 4; addr < pc; addr += 4) {
+		if (!ReadWord(addr, &word))
+		    break;
+		if ((word & 0xffff0000) == SaveRA) {
+		    save = sp + (short) (word & 0xffff);
+		    break;
+		}
+	    }
+	}
+
+	if (save >= 0) {
+	    if (!ReadWord(save, &ra))
+		break;
+	} else if (depth > 1 || (ra - 8 > low && ra - 8 <= pc))
+	    break;			// r31 is long gone, or was set by a
+					// call this function made
+	if (ra < 8 || ra % 4 != 0)
+	    break;
+	pc = ra - 8;
+	sp += frame;
+	ra = 0;				// only good for the innermost
+    }
+    return depth;
+}
+
+//----------------------------------------------------------------------
+// Profiler::ReadWord
+// 	Read the word at user address "vaddr" of the running program,
+//	without going through the machine (so without exceptions, or
+//	changing what is cached or counted).  Return FALSE if it isn't
+//	in memory.
+//----------------------------------------------------------------------
+
+bool
+Profiler::ReadWord(int vaddr, int *value)
+{
+    unsigned int paddr;
+
+    if (vaddr < 0 || vaddr % 4 != 0 || kernel->currentThread->space == NULL
+	    || kernel->currentThread->space->Translate(vaddr, &paddr, 0)
+		!= NoException)
+	return FALSE;
+    *value = WordToHost(*(unsigned int *) &kernel->machine->mainMemory[paddr]);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Profiler::Find
+// 	Return the entry counting "depth" addresses "pcs" of thread
+//	"threadID", adding it with a count of zero if there is none.
+//----------------------------------------------------------------------
+
+ProfileStack *
+Profiler::Find(int threadID, int depth, int *pcs)
+{
+    unsigned int hash = threadID;
+    ProfileStack *stack;
+
+    for (int i = 0; i < depth; i++)
+	hash = hash * 31 + pcs[i];
+    hash %= ProfileBuckets;
+    for (stack = buckets[hash]; stack != NULL; stack = stack->next) {
+	if (stack->threadID == threadID && stack->depth == depth
+		&& memcmp(stack->pcs, pcs, depth * sizeof(int)) == 0)
+	    return stack;
+    }
+
+    char *name = kernel->currentThread->getName();
+    stack = new ProfileStack;
+    stack->threadID = threadID;
+    stack->threadName = new char[strlen(name) + 1];
+    strcpy(stack->threadName, name);
+    stack->depth = depth;
+    memcpy(stack->pcs, pcs, depth * sizeof(int));
+    stack->count = 0;
+    stack->next = buckets[hash];
+    buckets[hash] = stack;
+    return stack;
+}
@@ -0,0 +1,88 @@
+// profile.h
+//	Data structures for the sampling profiler of user programs.
+//
+//	Every "interval" ticks of simulated time, the profiler records
+//	where the running user program is: its PC, and the return
+//	addresses of the calls that led there.  Identical stacks of the
+//	same thread are counted together.  When Nachos halts, the counts
+//	are written to a host file, one line per stack:
+//
+//		<count> <thread id> <thread name> <pc> <return pc> ...
+//
+//	innermost first, in hex.  The program stays symbol-free; the
+//	tool in coff2noff/ (noffprof) matches the addresses against the
+//	symbols coff2noff saved, and prints a flat profile or the folded
+//	stacks flame graphs are drawn from.
+//
+//	User code has no frame pointer we can trust, so stacks are found
+//	the way a debugger without symbols would: walking back from the
+//	PC to the "addiu sp,sp,-N" that made the function's frame, and
+//	from there to the "sw ra,M(sp)" that saved its return address.
+//	A function with no frame (like the system call stubs) still has
+//	its return address in r31, which only helps for the innermost one.
+//	This is what gcc generates for our user programs; it may give up
+//	early, but never reads outside the address space.
+//
+//	Samples are only taken while a user program runs: time spent in
+//	the kernel, or with every thread waiting, isn't charged to any.
+//
+// Copyright (c) 1992-1996 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define MaxProfileDepth	32	// deepest stack recorded
+#define ProfileBuckets	1024	// hash buckets of distinct stacks
+#define MaxFrameScan	1024	// instructions searched back for the
+				// start of a function
+
+// One distinct stack of one thread, and how often it was sampled.
+
+class ProfileStack {
+  public:
+    int threadID;
+    char *threadName;
+    int depth;				// return addresses, plus the PC
+    int pcs[MaxProfileDepth];		// pcs[0] is the PC
+    int count;				// samples with this stack
+    ProfileStack *next;			// in its hash bucket
+};
+
+// The profiler.  The machine calls Sample once simulated time
+// reaches NextSample (see Machine::NextStop).
+
+class Profiler {
+  public:
+    Profiler(int interval, char *fileName);
+					// Sample every "interval" ticks,
+					// into host file "fileName"
+    ~Profiler();			// Write out the profile
+
+    int NextSample() { return nextSample; }
+					// When the next sample is due
+    void Sample();			// Record the stack of the running
+					// user program
+
+  private:
+    int Unwind(int *pcs);		// Fill in "pcs" for the running
+					// program; return how many
+    bool ReadWord(int vaddr, int *value);
+					// A word of user memory, if it is
+					// valid; never faults
+    ProfileStack *Find(int threadID, int depth, int *pcs);
+					// The entry of this stack, added
+					// if it is new
+
+    int interval;
+    char *fileName;
+    int nextSample;			// tick of the next sample
+    int numSamples;			// taken so far
+    ProfileStack *buckets[ProfileBuckets];
+};
+
+#endif // PROFILE_H
@@ -34,6 +34,15 @@
 #define SC_ExecV	13
 #define SC_ThreadExit   14
 #define SC_ThreadJoin   15
+#define SC_PRead	16
+#define SC_PWrite	17
+#define SC_ReadV	18
+#define SC_WriteV	19
+#define SC_Mmap		20
+#define SC_Munmap	21
+#define SC_Rename	22
+#define SC_Link		23
+#define SC_Stat		24
 #define SC_Add		42
 #define SC_MSG		100
 
@@ -119,6 +128,34 @@ int Create(char *name, int size);
 /* Remove a Nachos file, with name "name" */
 int Remove(char *name);
 
+/* Give the Nachos file "from" the name "to", which may be in another
+ * directory; nothing is copied.  A file already named "to" is removed,
+ * unless either of them is a directory, which fails.  Return 1 on
+ * success, negative error code on failure.
+ */
+int Rename(char *from, char *to);
+
+/* Give the Nachos file "from" a second name, "to".  The file is only
+ * removed once all its names are.  Return 1 on success, negative error
+ * code on failure.
+ */
+int Link(char *from, char *to);
+
+/* The attributes of a Nachos file, filled in by Stat. */
+typedef struct {
+    int size;		/* in bytes */
+    int isDir;		/* 1 for a directory, 0 for a file */
+    int links;		/* number of names the file has */
+    int createTime;	/* ticks when it was created */
+    int modifyTime;	/* ticks when it was last written */
+} FileStat;
+
+/* Fill in "st" with the attributes of the Nachos file "name" ("/" for
+ * the root directory).  The file need not be open.  Return 1 on
+ * success, negative error code on failure.
+ */
+int Stat(char *name, FileStat *st);
+
 /* Open the Nachos file "name", and return an "OpenFileId" that can 
  * be used to read and write to the file.
  */
@@ -148,6 +185,42 @@ int Seek(int position, OpenFileId id);
  */
 int Close(OpenFileId id);
 
+/* Read/write "size" bytes at byte "position" of the open file, without
+ * using or moving its seek position.  Return the number of bytes
+ * actually read/written, or a negative error code.
+ */
+int PRead(char *buffer, int size, int position, OpenFileId id);
+int PWrite(char *buffer, int size, int position, OpenFileId id);
+
+/* One buffer of a vectored read or write: "len" bytes at "base". */
+typedef struct {
+    char *base;
+    int len;
+} IoVec;
+
+/* Read/write the "count" buffers of "vec", in order, starting at the
+ * seek position of the open file (which moves past them).  Stops early
+ * at the end of the file.  Return the total number of bytes read or
+ * written, or a negative error code.  At most IoVecMax buffers.
+ */
+#define IoVecMax	64
+int ReadV(IoVec *vec, int count, OpenFileId id);
+int WriteV(IoVec *vec, int count, OpenFileId id);
+
+/* Map "length" bytes of the open file "id", starting at byte "offset"
+ * (a multiple of the page size: 128 bytes, unless Nachos was started
+ * with -ps), into the address space.
+ * Pages are read from the file when first touched; the ones written
+ * are written back by Munmap, or when the program exits or halts.
+ * Return the address of the mapping, or a negative error code.
+ */
+int Mmap(OpenFileId id, int offset, int length);
+
+/* Write back and unmap the mapping at "addr", returned by Mmap.
+ * Return 1 on success, negative error code on failure.
+ */
+int Munmap(char *addr);
+
 
 /* User-level thread operations: Fork and Yield.  To allow multiple
  * threads to run within a user program. 
@@ -47,3 +47,82 @@ struct scnhdr {
         long            s_flags;        /* flags */
       };
  
+
+/* The symbol table (ECOFF), at f_symptr.  The symbolic header says
+ * where its parts are; offsets are from the start of the file.
+ */
+
+struct symhdr {
+        short   magic;          /* SYMHDRMAGIC */
+        short   vstamp;         /* version stamp */
+        long    ilineMax;       /* number of line number entries */
+        long    cbLine;
+        long    cbLineOffset;
+        long    idnMax;         /* dense numbers */
+        long    cbDnOffset;
+        long    ipdMax;         /* procedure descriptors */
+        long    cbPdOffset;
+        long    isymMax;        /* local symbols */
+        long    cbSymOffset;
+        long    ioptMax;        /* optimization symbols */
+        long    cbOptOffset;
+        long    iauxMax;        /* auxiliary symbols */
+        long    cbAuxOffset;
+        long    issMax;         /* bytes of local strings */
+        long    cbSsOffset;
+        long    issExtMax;      /* bytes of external strings */
+        long    cbSsExtOffset;
+        long    ifdMax;         /* file descriptors */
+        long    cbFdOffset;
+        long    crfd;           /* relative file descriptors */
+        long    cbRfdOffset;
+        long    iextMax;        /* external symbols */
+        long    cbExtOffset;
+      };
+
+#define SYMHDRMAGIC     0x7009
+
+/* One source file's part of the local symbols and strings. */
+
+struct fdr {
+        unsigned long   adr;            /* first text address */
+        long    rss;                    /* its file name */
+        long    issBase;                /* first of its local strings */
+        long    cbSs;
+        long    isymBase;               /* first of its local symbols */
+        long    csym;
+        long    ilineBase;
+        long    cline;
+        long    ioptBase;
+        long    copt;
+        unsigned short  ipdFirst;
+        short   cpd;
+        long    iauxBase;
+        long    caux;
+        long    rfdBase;
+        long    crfd;
+        unsigned long   bits;           /* language, flags */
+        long    cbLineOffset;
+        long    cbLine;
+      };
+
+/* A symbol: local, or inside an external one. */
+
+struct symr {
+        long    iss;            /* name, in the string table */
+        long    value;          /* for procedures, the address */
+        unsigned long   bits;   /* st, sc, index; see below */
+      };
+
+#define SYM_ST(s)       ((s).bits & 0x3f)               /* symbol type */
+#define SYM_SC(s)       (((s).bits >> 6) & 0x1f)        /* storage class */
+
+#define stProc          6       /* a procedure */
+#define stStaticProc    14      /* a static procedure */
+#define scText          1       /* in .text */
+
+struct extr {
+        short   reserved;
+        short   ifd;            /* file it was defined in */
+        struct symr asym;
+      };
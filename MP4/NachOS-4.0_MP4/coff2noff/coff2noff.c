@@ -10,6 +10,13 @@
  * 	ld with  -N -T 0
  * to make sure the object file has no shared text.
  *
+ * Given a third file name, also writes the addresses and names of the
+ * procedures in the COFF symbol table to that file, one per line
+ *	<address, in hex> <name>
+ * sorted by address, since NOFF has no room for them.  Nachos itself
+ * never looks at them; tools like noffprof use them to name the
+ * addresses in a user program.
+ *
  * Also assumes that the COFF file has at most 3 segments:
  *	.text	-- read-only executable instructions 
  *	.data	-- initialized data
@@ -148,6 +155,120 @@ void Write(int fd, char *buf, int nBytes)
     }
 }
 
+/* one procedure, for the symbol file */
+typedef struct {
+    unsigned int addr;
+    char *name;
+} Symbol;
+
+static int
+CompareSymbols(const void *a, const void *b)
+{
+    unsigned int x = ((const Symbol *) a)->addr;
+    unsigned int y = ((const Symbol *) b)->addr;
+
+    return (x < y) ? -1 : (x > y);
+}
+
+/* read "size" bytes at "offset" of the COFF file into a new buffer */
+char *ReadAt(int fd, long offset, long size)
+{
+    char *buffer = malloc(size + 1);
+
+    lseek(fd, offset, 0);
+    Read(fd, buffer, size);
+    buffer[size] = '\0';
+    return buffer;
+}
+
+/* write the procedures in the symbol table of the COFF file "fdIn" to
+ * "symFileName": the static ones are only among the local symbols of
+ * the file they are in; the external ones are also there, unless the
+ * file had no local symbols, so we take both, and drop duplicates.
+ */
+void WriteSymbols(int fdIn, struct filehdr *fileh, char *symFileName)
+{
+    struct symhdr symh;
+    struct fdr *fdrs;
+    struct symr *locals;
+    struct extr *externs;
+    char *localStrings, *externStrings;
+    Symbol *syms;
+    int numSyms = 0, i, j;
+    FILE *symFile;
+
+    symFile = fopen(symFileName, "w");
+    if (symFile == NULL) {
+	perror(symFileName);
+	unlink(noffFileName);
+	exit(1);
+    }
+    if (fileh->f_symptr == 0 || fileh->f_nsyms < sizeof(symh)) {
+	fprintf(stderr, "No symbol table, %s is empty\n", symFileName);
+	fclose(symFile);
+	return;
+    }
+    lseek(fdIn, fileh->f_symptr, 0);
+    ReadStruct(fdIn, symh);
+    if (ShortToHost(symh.magic) != SYMHDRMAGIC) {
+	fprintf(stderr, "Unknown symbol table, %s is empty\n", symFileName);
+	fclose(symFile);
+	return;
+    }
+    symh.ifdMax = WordToHost(symh.ifdMax);
+    symh.isymMax = WordToHost(symh.isymMax);
+    symh.iextMax = WordToHost(symh.iextMax);
+    fdrs = (struct fdr *) ReadAt(fdIn, WordToHost(symh.cbFdOffset),
+				symh.ifdMax * sizeof(struct fdr));
+    locals = (struct symr *) ReadAt(fdIn, WordToHost(symh.cbSymOffset),
+				symh.isymMax * sizeof(struct symr));
+    externs = (struct extr *) ReadAt(fdIn, WordToHost(symh.cbExtOffset),
+				symh.iextMax * sizeof(struct extr));
+    localStrings = ReadAt(fdIn, WordToHost(symh.cbSsOffset),
+				WordToHost(symh.issMax));
+    externStrings = ReadAt(fdIn, WordToHost(symh.cbSsExtOffset),
+				WordToHost(symh.issExtMax));
+    syms = (Symbol *) malloc((symh.isymMax + symh.iextMax) * sizeof(Symbol));
+
+    for (i = 0; i < symh.ifdMax; i++) {
+	long base = WordToHost(fdrs[i].isymBase);
+	long count = WordToHost(fdrs[i].csym);
+	char *strings = localStrings + WordToHost(fdrs[i].issBase);
+
+	for (j = base; j < base + count && j < symh.isymMax; j++) {
+	    locals[j].bits = WordToHost(locals[j].bits);
+	    if ((SYM_ST(locals[j]) == stProc || 
+			SYM_ST(locals[j]) == stStaticProc) &&
+			SYM_SC(locals[j]) == scText) {
+		syms[numSyms].addr = WordToHost(locals[j].value);
+		syms[numSyms++].name = strings + WordToHost(locals[j].iss);
+	    }
+	}
+    }
+    for (i = 0; i < symh.iextMax; i++) {
+	externs[i].asym.bits = WordToHost(externs[i].asym.bits);
+	if (SYM_ST(externs[i].asym) == stProc && 
+			SYM_SC(externs[i].asym) == scText) {
+	    syms[numSyms].addr = WordToHost(externs[i].asym.value);
+	    syms[numSyms++].name = externStrings + 
+					WordToHost(externs[i].asym.iss);
+	}
+    }
+
+    qsort(syms, numSyms, sizeof(Symbol), CompareSymbols);
+    for (i = 0; i < numSyms; i++) {
+	if (i == 0 || syms[i].addr != syms[i - 1].addr)
+	    fprintf(symFile, "%08x %s\n", syms[i].addr, syms[i].name);
+    }
+    fclose(symFile);
+    free(syms);
+    free(fdrs);
+    free(locals);
+    free(externs);
+    free(localStrings);
+    free(externStrings);
+}
+
 int main(int argc, char **argv)
 {
     int fdIn, fdOut, numsections, i, inNoffFile;
@@ -157,8 +278,8 @@ int main(int argc, char **argv)
     char *buffer;
     NoffHeader noffH;
 
-    if (argc < 2) {
-	fprintf(stderr, "Usage: %s <coffFileName> <noffFileName>\n", argv[0]);
+    if (argc < 3) {
+	fprintf(stderr, "Usage: %s <coffFileName> <noffFileName> [<symFileName>]\n", argv[0]);
 	exit(1);
     }
     
@@ -181,6 +302,8 @@ int main(int argc, char **argv)
     ReadStruct(fdIn,fileh);
     fileh.f_magic = ShortToHost(fileh.f_magic);
     fileh.f_nscns = ShortToHost(fileh.f_nscns); 
+    fileh.f_symptr = WordToHost(fileh.f_symptr);
+    fileh.f_nsyms = WordToHost(fileh.f_nsyms);
     if (fileh.f_magic != MIPSELMAGIC) {
 	fprintf(stderr, "File is not a MIPSEL COFF file\n");
         unlink(noffFileName);
@@ -294,6 +417,8 @@ int main(int argc, char **argv)
     SwapHeader(&noffH);
     
     Write(fdOut, (char *)&noffH, sizeof(NoffHeader));
+    if (argc > 3)
+	WriteSymbols(fdIn, &fileh, argv[3]);
     close(fdIn);
     close(fdOut);
     exit(0);
@@ -0,0 +1,335 @@
+/* noffprof.c
+ *
+ * This program reads a profile written by Nachos (nachos -prof), and
+ * names the addresses in it, using the symbol files coff2noff wrote
+ * for the user programs (coff2noff foo.coff foo foo.sym).
+ *
+ * Each line of the profile counts the samples of one thread that had
+ * one call stack, innermost address first:
+ *	<count> <thread id> <thread name> <pc> <return pc> ...
+ * An address belongs to the procedure with the highest address at or
+ * below it.  The symbol file used for a thread is the one named after
+ * its program (thread "/dir/foo" uses "foo.sym"), or the only one given.
+ *
+ * By default, prints a flat profile of each thread: for each procedure,
+ * the samples taken in it ("self"), and those taken while it was on
+ * the stack ("total").  With -f, prints the folded stacks flame graphs
+ * are drawn from instead, one line per stack:
+ *	<program>;<outermost procedure>;...;<innermost procedure> <count>
+ *
+ * Copyright (c) 1992-1993 The Regents of the University of California.
+ * All rights reserved.  See copyright.h for copyright notice and limitation
+ * of liability and disclaimer of warranty provisions.
+ */
+
+#define MAIN
+#include "copyright.h"
+#undef MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MaxDepth	64	/* deepest stack we keep */
+#define MaxLine		4096	/* longest line we read */
+
+/* one procedure of a program */
+typedef struct {
+    unsigned int addr;
+    char *name;
+} Symbol;
+
+/* the symbols of one program, sorted by address */
+typedef struct {
+    char *program;		/* the file name, less ".sym" */
+    Symbol *syms;
+    int numSyms;
+} SymTable;
+
+/* one line of the profile */
+typedef struct {
+    int count;
+    int thread;
+    char *threadName;
+    int depth;
+    unsigned int pcs[MaxDepth];
+} Stack;
+
+/* a procedure in a flat profile, or a line of folded output */
+typedef struct {
+    char *name;
+    int self, total;
+    int lastStack;		/* last stack "total" counted */
+} Entry;
+
+SymTable *tables;
+int numTables;
+Stack *stacks;
+int numStacks;
+
+/* like strdup, but exits when out of memory */
+char *Copy(char *s)
+{
+    char *copy = malloc(strlen(s) + 1);
+
+    if (copy == NULL) {
+	fprintf(stderr, "Out of memory\n");
+	exit(1);
+    }
+    return strcpy(copy, s);
+}
+
+/* the name of file "path", less directory and "suffix" */
+char *BaseName(char *path, char *suffix)
+{
+    char *slash = strrchr(path, '/');
+    char *name = Copy(slash == NULL ? path : slash + 1);
+    int len = strlen(name) - strlen(suffix);
+
+    if (len > 0 && strcmp(name + len, suffix) == 0)
+	name[len] = '\0';
+    return name;
+}
+
+/* read a symbol file; coff2noff sorted it already */
+void ReadSymbols(char *fileName, SymTable *table)
+{
+    FILE *file = fopen(fileName, "r");
+    char line[MaxLine], name[MaxLine];
+    unsigned int addr;
+    int max = 64;
+
+    if (file == NULL) {
+	perror(fileName);
+	exit(1);
+    }
+    table->program = BaseName(fileName, ".sym");
+    table->syms = malloc(max * sizeof(Symbol));
+    table->numSyms = 0;
+    while (fgets(line, MaxLine, file) != NULL) {
+	if (sscanf(line, "%x %s", &addr, name) != 2)
+	    continue;
+	if (table->numSyms == max) {
+	    max *= 2;
+	    table->syms = realloc(table->syms, max * sizeof(Symbol));
+	}
+	table->syms[table->numSyms].addr = addr;
+	table->syms[table->numSyms++].name = Copy(name);
+    }
+    fclose(file);
+}
+
+/* read the profile; return the sampling interval */
+int ReadProfile(char *fileName)
+{
+    FILE *file = fopen(fileName, "r");
+    char line[MaxLine], name[MaxLine], *p;
+    int interval = 0, max = 256, n;
+    Stack *stack;
+
+    if (file == NULL) {
+	perror(fileName);
+	exit(1);
+    }
+    stacks = malloc(max * sizeof(Stack));
+    numStacks = 0;
+    while (fgets(line, MaxLine, file) != NULL) {
+	if (line[0] == '#') {
+	    sscanf(line, "# nachos profile, one sample every %d", &interval);
+	    continue;
+	}
+	if (numStacks == max) {
+	    max *= 2;
+	    stacks = realloc(stacks, max * sizeof(Stack));
+	}
+	stack = &stacks[numStacks];
+	if (sscanf(line, "%d %d %s%n", &stack->count, &stack->thread,
+			name, &n) != 3)
+	    continue;
+	stack->threadName = Copy(name);
+	stack->depth = 0;
+	for (p = line + n; stack->depth < MaxDepth &&
+		sscanf(p, "%x%n", &stack->pcs[stack->depth], &n) == 1; p += n)
+	    stack->depth++;
+	numStacks++;
+    }
+    fclose(file);
+    return interval;
+}
+
+/* the symbols for thread "threadName", or NULL */
+SymTable *FindTable(char *threadName)
+{
+    char *program = BaseName(threadName, "");
+    int i;
+
+    for (i = 0; i < numTables; i++) {
+	if (strcmp(tables[i].program, program) == 0) {
+	    free(program);
+	    return &tables[i];
+	}
+    }
+    free(program);
+    return (numTables == 1) ? &tables[0] : NULL;
+}
+
+/* the name of address "pc": its procedure's, or the address in hex */
+char *Symbolize(SymTable *table, unsigned int pc)
+{
+    static char hex[16];
+    int low = 0, high, mid;
+
+    if (table != NULL && table->numSyms > 0 && table->syms[0].addr <= pc) {
+	high = table->numSyms - 1;
+	while (low < high) {		/* last symbol at or below pc */
+	    mid = (low + high + 1) / 2;
+	    if (table->syms[mid].addr <= pc)
+		low = mid;
+	    else
+		high = mid - 1;
+	}
+	return table->syms[low].name;
+    }
+    sprintf(hex, "0x%x", pc);
+    return hex;
+}
+
+/* the entry named "name" in "entries", added if it isn't there */
+Entry *FindEntry(Entry **entries, int *numEntries, int *max, char *name)
+{
+    int i;
+
+    for (i = 0; i < *numEntries; i++) {
+	if (strcmp((*entries)[i].name, name) == 0)
+	    return &(*entries)[i];
+    }
+    if (*numEntries == *max) {
+	*max *= 2;
+	*entries = realloc(*entries, *max * sizeof(Entry));
+    }
+    (*entries)[*numEntries].name = Copy(name);
+    (*entries)[*numEntries].self = 0;
+    (*entries)[*numEntries].total = 0;
+    (*entries)[*numEntries].lastStack = -1;
+    return &(*entries)[(*numEntries)++];
+}
+
+static int
+CompareSelf(const void *a, const void *b)
+{
+    const Entry *x = a, *y = b;
+
+    if (x->self != y->self)
+	return y->self - x->self;
+    if (x->total != y->total)
+	return y->total - x->total;
+    return strcmp(x->name, y->name);
+}
+
+static int
+CompareNames(const void *a, const void *b)
+{
+    return strcmp(((const Entry *) a)->name, ((const Entry *) b)->name);
+}
+
+/* the flat profile of each thread, in the order they were first seen */
+void PrintFlat(int interval)
+{
+    int max = 64, numEntries, samples, i, j, k;
+    Entry *entries = malloc(max * sizeof(Entry)), *entry;
+    SymTable *table;
+
+    for (i = 0; i < numStacks; i++) {
+	for (j = 0; j < i; j++)
+	    if (stacks[j].thread == stacks[i].thread)
+		break;
+	if (j < i)
+	    continue;			/* thread already printed */
+
+	table = FindTable(stacks[i].threadName);
+	numEntries = 0;
+	samples = 0;
+	for (j = i; j < numStacks; j++) {
+	    if (stacks[j].thread != stacks[i].thread || stacks[j].depth == 0)
+		continue;
+	    samples += stacks[j].count;
+	    entry = FindEntry(&entries, &numEntries, &max,
+				Symbolize(table, stacks[j].pcs[0]));
+	    entry->self += stacks[j].count;
+	    for (k = 0; k < stacks[j].depth; k++) {
+		entry = FindEntry(&entries, &numEntries, &max,
+				Symbolize(table, stacks[j].pcs[k]));
+		if (entry->lastStack != j) {	/* once, if recursive */
+		    entry->total += stacks[j].count;
+		    entry->lastStack = j;
+		}
+	    }
+	}
+
+	printf("Thread %d (%s): %d samples, one every %d ticks%s\n",
+		stacks[i].thread, stacks[i].threadName, samples, interval,
+		(table == NULL) ? ", no symbols" : "");
+	printf("   self       %%   total       %%  procedure\n");
+	qsort(entries, numEntries, sizeof(Entry), CompareSelf);
+	for (j = 0; j < numEntries; j++) {
+	    printf("%7d  %5.1f%%  %6d  %5.1f%%  %s\n", entries[j].self,
+		100.0 * entries[j].self / samples, entries[j].total,
+		100.0 * entries[j].total / samples, entries[j].name);
+	    free(entries[j].name);
+	}
+	printf("\n");
+    }
+    free(entries);
+}
+
+/* the folded stacks, with identical ones (after naming) merged */
+void PrintFolded()
+{
+    int max = 64, numEntries = 0, i, k;
+    Entry *entries = malloc(max * sizeof(Entry));
+    char *line = malloc(MaxLine + MaxDepth * MaxLine), *end;
+    SymTable *table;
+
+    for (i = 0; i < numStacks; i++) {
+	table = FindTable(stacks[i].threadName);
+	end = line + sprintf(line, "%s", stacks[i].threadName);
+	for (k = stacks[i].depth - 1; k >= 0; k--)
+	    end += sprintf(end, ";%s", Symbolize(table, stacks[i].pcs[k]));
+	FindEntry(&entries, &numEntries, &max, line)->self +=
+							stacks[i].count;
+    }
+    qsort(entries, numEntries, sizeof(Entry), CompareNames);
+    for (i = 0; i < numEntries; i++) {
+	printf("%s %d\n", entries[i].name, entries[i].self);
+	free(entries[i].name);
+    }
+    free(entries);
+    free(line);
+}
+
+int main(int argc, char **argv)
+{
+    int folded = 0, first = 1, interval, i;
+
+    if (argc > 1 && strcmp(argv[1], "-f") == 0) {
+	folded = 1;
+	first = 2;
+    }
+    if (argc - first < 1) {
+	fprintf(stderr, "Usage: %s [-f] <profile> [<symFileName> ...]\n",
+		argv[0]);
+	exit(1);
+    }
+
+    numTables = argc - first - 1;
+    tables = malloc((numTables + 1) * sizeof(SymTable));
+    for (i = 0; i < numTables; i++)
+	ReadSymbols(argv[first + 1 + i], &tables[i]);
+    interval = ReadProfile(argv[first]);
+
+    if (folded)
+	PrintFolded();
+    else
+	PrintFlat(interval);
+    exit(0);
+}